@@ -0,0 +1,176 @@
+// Measures parse, serialize and mason-to-json throughput
+// on the documents made by mason-gen-corpus.
+
+#include <mason/mason.h>
+#include <mason/writer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <spawn.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double minTime = 1;
+
+struct Result {
+	size_t runs = 0;
+	double seconds = 0;
+};
+
+// Run a function until it has taken at least minTime seconds,
+// and at least three times
+template<typename F>
+bool measure(Result &res, F func)
+{
+	while (res.runs < 3 || res.seconds < minTime) {
+		auto start = Clock::now();
+		if (!func()) {
+			return false;
+		}
+		res.seconds += std::chrono::duration<double>(
+			Clock::now() - start).count();
+		res.runs += 1;
+	}
+
+	return true;
+}
+
+void report(const char *path, size_t size, const char *op, Result res)
+{
+	const char *base = strrchr(path, '/');
+	double mib = double(size) / (1024 * 1024);
+	printf("%-20s %6.1f MiB  %-14s %9.1f MB/s %9.1f docs/s\n",
+		base ? base + 1 : path, mib, op,
+		size * res.runs / res.seconds / 1e6, res.runs / res.seconds);
+	fflush(stdout);
+}
+
+// Convert a file with mason-to-json, throwing away the output
+bool runConverter(const char *exe, const char *path)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, 0, path, O_RDONLY, 0);
+	posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+
+	char *argv[] = {(char *)exe, nullptr};
+	pid_t pid;
+	int err = posix_spawn(&pid, exe, &actions, nullptr, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (err != 0) {
+		fprintf(stderr, "%s: %s\n", exe, strerror(err));
+		return false;
+	}
+
+	int status;
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return false;
+	}
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "%s: Failed to convert %s\n", exe, path);
+		return false;
+	}
+
+	return true;
+}
+
+bool bench(const char *path, const char *converter)
+{
+	std::string err;
+	Mason::FileData file;
+	if (!file.open(path, &err)) {
+		fprintf(stderr, "%s\n", err.c_str());
+		return false;
+	}
+
+	size_t size = file.size();
+	Result res;
+	bool ok = measure(res, [&] {
+		Mason::Value val;
+		if (!Mason::parse(file.view(), val, &err)) {
+			fprintf(stderr, "%s: Failed to parse: %s\n", path, err.c_str());
+			return false;
+		}
+		return true;
+	});
+	if (!ok) {
+		return false;
+	}
+	report(path, size, "parse", res);
+
+	res = {};
+	measure(res, [&] {
+		Mason::Value val;
+		return Mason::parseIndexed(file.view(), val);
+	});
+	report(path, size, "parse-indexed", res);
+
+	// Serialized documents can have a different size from the input,
+	// but the input's size is used so that the numbers are comparable
+	Mason::Value val;
+	Mason::parse(file.view(), val);
+	std::string out;
+	res = {};
+	measure(res, [&] {
+		out.clear();
+		Mason::Writer w(out);
+		Mason::serialize(w, val);
+		return true;
+	});
+	report(path, size, "serialize", res);
+
+	if (converter) {
+		res = {};
+		if (!measure(res, [&] { return runConverter(converter, path); })) {
+			return false;
+		}
+		report(path, size, "mason-to-json", res);
+	}
+
+	return true;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = argv[0];
+	const char *converter = nullptr;
+	int i = 1;
+	while (i + 1 < argc && strncmp(argv[i], "--", 2) == 0) {
+		if (strcmp(argv[i], "--mason-to-json") == 0) {
+			converter = argv[i + 1];
+		} else if (strcmp(argv[i], "--time") == 0) {
+			minTime = atof(argv[i + 1]);
+		} else {
+			break;
+		}
+		i += 2;
+	}
+
+	if (i >= argc || argv[i][0] == '-') {
+		fprintf(stderr,
+			"Usage: %s [--mason-to-json <path>] [--time <seconds>] <file>...\n",
+			name);
+		return 1;
+	}
+
+	bool ok = true;
+	for (; i < argc; ++i) {
+		ok = bench(argv[i], converter) && ok;
+	}
+
+	return ok ? 0 : 1;
+}
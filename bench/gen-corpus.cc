@@ -0,0 +1,355 @@
+// Generates the documents used by the benchmarks.
+// Each output file's name (without the extension) picks its shape,
+// and the contents only depend on the shape and size,
+// so that results can be compared between runs and machines.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace {
+
+// Only the generator's raw output is used, since the standard
+// distributions can differ between standard libraries
+class Gen {
+public:
+	uint64_t next() { return rng_(); }
+	uint64_t below(uint64_t n) { return rng_() % n; }
+	bool chance(int percent) { return below(100) < uint64_t(percent); }
+
+	std::string word() {
+		static const char *words[] = {
+			"alpha", "bravo", "charlie", "delta", "echo", "foxtrot",
+			"golf", "hotel", "india", "juliett", "kilo", "lima",
+			"mike", "november", "oscar", "papa", "quebec", "romeo",
+		};
+		return words[below(sizeof(words) / sizeof(*words))];
+	}
+
+	std::string sentence(int words) {
+		std::string str;
+		for (int i = 0; i < words; ++i) {
+			if (i > 0) {
+				str += ' ';
+			}
+			str += word();
+		}
+		return str;
+	}
+
+private:
+	std::mt19937_64 rng_{12345};
+};
+
+void indent(std::string &out, int depth)
+{
+	out.append(depth * 2, ' ');
+}
+
+// Arrays of integers, floats and the other number syntaxes
+void numbers(Gen &g, std::string &out, size_t size)
+{
+	out += "[\n";
+	while (out.size() < size) {
+		out += "  [";
+		out += std::to_string(int64_t(g.next() >> 20) - (int64_t(1) << 43));
+		out += ", ";
+		out += std::to_string(g.below(1000));
+		out += ", ";
+		out += std::to_string(g.below(1000000));
+		out += '.';
+		out += std::to_string(g.below(1000000));
+		out += ", -";
+		out += std::to_string(g.below(10));
+		out += '.';
+		out += std::to_string(g.below(1000));
+		out += "e-";
+		out += std::to_string(g.below(300));
+		out += ", ";
+		out += std::to_string(g.next());
+		char buf[64];
+		snprintf(buf, sizeof(buf), ", 0x%llx, 0o%llo, 0b%d%d%d%d, 1'000'%03d",
+			(unsigned long long)g.below(1 << 30),
+			(unsigned long long)g.below(1 << 20),
+			int(g.below(2)), int(g.below(2)), int(g.below(2)), int(g.below(2)),
+			int(g.below(1000)));
+		out += buf;
+		out += "]\n";
+	}
+	out += "]\n";
+}
+
+// Records with quoted strings, many of which need escapes
+void strings(Gen &g, std::string &out, size_t size)
+{
+	static const char *escapes[] = {
+		"\\n", "\\t", "\\\"", "\\\\", "\\u00e9", "\\u2603", "\\x41",
+		"\\ud83d\\ude00", "\\r",
+	};
+
+	out += "[\n";
+	for (int id = 0; out.size() < size; ++id) {
+		out += "  {id: ";
+		out += std::to_string(id);
+		out += ", title: \"";
+		out += g.sentence(3);
+		out += "\", body: \"";
+		int parts = 4 + g.below(12);
+		for (int i = 0; i < parts; ++i) {
+			out += g.sentence(1 + g.below(6));
+			if (g.chance(60)) {
+				out += escapes[g.below(sizeof(escapes) / sizeof(*escapes))];
+			} else {
+				out += ' ';
+			}
+		}
+		out += "\", \"quoted key\": \"caf\\u00e9\"}\n";
+	}
+	out += "]\n";
+}
+
+void nestedValue(Gen &g, std::string &out, int depth)
+{
+	if (depth == 0) {
+		out += std::to_string(g.below(100));
+		return;
+	}
+
+	if (depth % 2 == 0) {
+		out += "{k";
+		out += std::to_string(depth);
+		out += ": ";
+		nestedValue(g, out, depth - 1);
+		out += ", n: ";
+		out += std::to_string(g.below(100));
+		out += '}';
+	} else {
+		out += '[';
+		nestedValue(g, out, depth - 1);
+		out += ", true]";
+	}
+}
+
+// Small values nested deeply, within the default depth limit
+void nested(Gen &g, std::string &out, size_t size)
+{
+	out += "[\n";
+	while (out.size() < size) {
+		out += "  ";
+		nestedValue(g, out, 20 + g.below(60));
+		out += '\n';
+	}
+	out += "]\n";
+}
+
+// One object with a very large number of members
+void wide(Gen &g, std::string &out, size_t size)
+{
+	out += "{\n";
+	for (int i = 0; out.size() < size; ++i) {
+		out += "  field_";
+		out += std::to_string(i);
+		out += ": ";
+		switch (g.below(4)) {
+		case 0:
+			out += std::to_string(g.below(1000000));
+			break;
+		case 1:
+			out += '"';
+			out += g.word();
+			out += '"';
+			break;
+		case 2:
+			out += g.chance(50) ? "true" : "false";
+			break;
+		default:
+			out += "null";
+			break;
+		}
+		out += '\n';
+	}
+	out += "}\n";
+}
+
+// A configuration file: top-level keys without braces,
+// bare keys, sections and lots of comments
+void config(Gen &g, std::string &out, size_t size)
+{
+	out += "// Generated configuration\n\n";
+	for (int section = 0; out.size() < size; ++section) {
+		out += "/*\n * Section ";
+		out += std::to_string(section);
+		out += "\n * ";
+		out += g.sentence(10);
+		out += "\n */\n";
+		out += "section_";
+		out += std::to_string(section);
+		out += ": {\n";
+
+		int keys = 5 + g.below(20);
+		for (int i = 0; i < keys; ++i) {
+			if (g.chance(50)) {
+				indent(out, 1);
+				out += "// ";
+				out += g.sentence(6);
+				out += '\n';
+			}
+
+			indent(out, 1);
+			out += g.word();
+			out += '-';
+			out += std::to_string(i);
+			out += ": ";
+			switch (g.below(4)) {
+			case 0:
+				out += std::to_string(g.below(65536));
+				break;
+			case 1:
+				out += '"';
+				out += g.sentence(2);
+				out += '"';
+				break;
+			case 2:
+				out += "[\"";
+				out += g.word();
+				out += "\", \"";
+				out += g.word();
+				out += "\"]";
+				break;
+			default:
+				out += g.chance(50) ? "true" : "false";
+				break;
+			}
+			if (g.chance(30)) {
+				out += " /* ";
+				out += g.word();
+				out += " */";
+			}
+			out += '\n';
+		}
+		out += "}\n\n";
+	}
+}
+
+// Multi-line strings and raw strings
+void multiline(Gen &g, std::string &out, size_t size)
+{
+	out += "[\n";
+	while (out.size() < size) {
+		out += "  {\n    text:\n";
+		int lines = 2 + g.below(10);
+		for (int i = 0; i < lines; ++i) {
+			out += "      |";
+			out += g.sentence(1 + g.below(10));
+			out += '\n';
+		}
+
+		out += "    raw: r\"";
+		out += g.sentence(5);
+		out += "\\no\\escapes\"\n";
+		out += "    hashed: r##\"";
+		out += g.sentence(3);
+		out += " \"quoted\"# ";
+		out += g.sentence(3);
+		out += "\"##\n  }\n";
+	}
+	out += "]\n";
+}
+
+// Large binary strings, mostly escapes
+void binary(Gen &g, std::string &out, size_t size)
+{
+	static const char *hex = "0123456789abcdef";
+
+	out += "[\n";
+	while (out.size() < size) {
+		out += "  b\"";
+		size_t n = 1024 + g.below(64 * 1024);
+		for (size_t i = 0; i < n; ++i) {
+			unsigned char ch = g.next();
+			if (ch >= 0x20 && ch < 0x7f && ch != '"' && ch != '\\') {
+				out += ch;
+			} else {
+				out += "\\x";
+				out += hex[ch >> 4];
+				out += hex[ch & 0x0f];
+			}
+		}
+		out += "\"\n";
+	}
+	out += "]\n";
+}
+
+struct Shape {
+	const char *name;
+	std::function<void(Gen &, std::string &, size_t)> gen;
+};
+
+const Shape shapes[] = {
+	{"numbers", numbers},
+	{"strings", strings},
+	{"nested", nested},
+	{"wide", wide},
+	{"config", config},
+	{"multiline", multiline},
+	{"binary", binary},
+};
+
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = argv[0];
+	size_t size = 4;
+	if (argc >= 3 && strcmp(argv[1], "-s") == 0) {
+		size = strtoul(argv[2], nullptr, 10);
+		argc -= 2;
+		argv += 2;
+	}
+
+	if (argc < 2 || size == 0) {
+		fprintf(stderr, "Usage: %s [-s MiB] <file>...\n", name);
+		fprintf(stderr, "Shapes:");
+		for (auto &shape: shapes) {
+			fprintf(stderr, " %s", shape.name);
+		}
+		fprintf(stderr, "\n");
+		return 1;
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		std::string_view path = argv[i];
+		std::string_view base = path.substr(path.find_last_of('/') + 1);
+		base = base.substr(0, base.find('.'));
+
+		const Shape *found = nullptr;
+		for (auto &shape: shapes) {
+			if (base == shape.name) {
+				found = &shape;
+			}
+		}
+
+		if (!found) {
+			fprintf(stderr, "%s: Unknown shape\n", argv[i]);
+			return 1;
+		}
+
+		Gen g;
+		std::string out;
+		found->gen(g, out, size * 1024 * 1024);
+
+		FILE *f = fopen(argv[i], "wb");
+		if (!f || fwrite(out.data(), 1, out.size(), f) != out.size() ||
+				fclose(f) != 0) {
+			perror(argv[i]);
+			return 1;
+		}
+	}
+
+	return 0;
+}
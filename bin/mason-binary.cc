@@ -0,0 +1,56 @@
+#include <mason/mason.h>
+#include <mason/binary.h>
+#include <mason/writer.h>
+#include <iostream>
+
+// Convert MASON to the binary encoding, or back with -d
+int main(int argc, char **argv)
+{
+	const char *name = argv[0];
+	bool decode = argc >= 2 && std::string_view(argv[1]) == "-d";
+	if (decode) {
+		argc -= 1;
+		argv += 1;
+	}
+
+	if (argc > 2) {
+		std::cerr << "Usage: " << name << " [-d] [file]\n";
+		return 1;
+	}
+
+	std::string err;
+	Mason::FileData file;
+	bool ok;
+	if (argc == 1) {
+		ok = file.open(0, &err);
+	} else {
+		ok = file.open(argv[1], &err);
+	}
+
+	Mason::Value val;
+	if (ok && decode) {
+		ok = Mason::decodeBinary(file.view(), val, &err);
+	} else if (ok) {
+		ok = Mason::parseInPlace(file.view(), val, &err);
+	}
+
+	if (!ok) {
+		std::cerr << "Failed to " << (decode ? "decode" : "parse")
+			<< ": " << err << '\n';
+		return 1;
+	}
+
+	Mason::Writer w(1);
+	if (decode) {
+		Mason::serialize(w, val);
+	} else {
+		Mason::encodeBinary(w, val);
+	}
+
+	if (!w.flush()) {
+		std::cerr << "Failed to write output\n";
+		return 1;
+	}
+
+	return 0;
+}
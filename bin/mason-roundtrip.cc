@@ -1,33 +1,32 @@
 #include <mason/mason.h>
+#include <mason/writer.h>
 #include <iostream>
-#include <fstream>
 
 int main(int argc, char **argv)
 {
-	std::fstream fstream;
-	std::istream *is;
-
+	std::string err;
+	Mason::Value val;
+	bool ok;
 	if (argc == 1) {
-		is = &std::cin;
+		ok = Mason::parseFile(0, val, &err);
 	} else if (argc == 2) {
-		fstream.open(argv[1]);
-		if (!fstream) {
-			std::cerr << "Failed to open " << argv[1] << '\n';
-			return 1;
-		}
-		is = &fstream;
+		ok = Mason::parseFile(argv[1], val, &err);
 	} else {
 		std::cerr << "Usage: " << argv[0] << " <file>\n";
 		return 1;
 	}
 
-	std::string err;
-	Mason::Value val;
-	if (!Mason::parse(*is, val, &err)) {
+	if (!ok) {
 		std::cerr << "Failed to parse: " << err << '\n';
 		return 1;
 	}
 
-	Mason::serialize(std::cout, val);
+	Mason::Writer w(1);
+	Mason::serializeParallel(w, val);
+	if (!w.flush()) {
+		std::cerr << "Failed to write output\n";
+		return 1;
+	}
+
 	return 0;
 }
@@ -1,165 +1,217 @@
+#include <algorithm>
 #include <charconv>
 #include <mason/mason.h>
-#include <iostream>
+#include <mason/codec.h>
+#include <mason/keys.h>
+#include <mason/writer.h>
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <span>
 
-void printB64(const unsigned char *chars, size_t n, std::ostream &os)
+void printB64(const unsigned char *chars, size_t n, Mason::Writer &w)
 {
-	const char *alphabet =
-		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-		"abcdefghijklmnopqrstuvwxyz"
-		"0123456789+/";
-
-	size_t i = 0;
-	size_t j = 0;
-	unsigned char ch3[3];
-	unsigned char ch4[4];
-
-	while (n--) {
-		ch3[i++] = *(chars++);
-		if (i == 3) {
-			ch4[0] = (ch3[0] & 0xfc) >> 2;
-			ch4[1] = ((ch3[0] & 0x03) << 4) + ((ch3[1] & 0xf0) >> 4);
-			ch4[2] = ((ch3[1] & 0x0f) << 2) + ((ch3[2] & 0xc0) >> 6);
-			ch4[3] = ch3[2] & 0x3f;
-
-			for (i = 0; (i < 4) ; i++) {
-				os << alphabet[ch4[i]];
-			}
-			i = 0;
-		}
-	}
-
-	if (i) {
-		for (j = i; j < 3; j++) {
-			ch3[j] = '\0';
-		}
-
-		ch4[0] = (ch3[0] & 0xfc) >> 2;
-		ch4[1] = ((ch3[0] & 0x03) << 4) + ((ch3[1] & 0xf0) >> 4);
-		ch4[2] = ((ch3[1] & 0x0f) << 2) + ((ch3[2] & 0xc0) >> 6);
-		ch4[3] = ch3[2] & 0x3f;
-
-		for (j = 0; (j < i + 1); j++) {
-			os << alphabet[ch4[j]];
-		}
-
-		while((i++ < 3)) {
-			os << '=';
-		}
+	// Encode a multiple of 3 bytes at a time, so that only the end is padded
+	char buf[4096];
+	while (n > 0) {
+		size_t chunk = std::min(n, sizeof(buf) / 4 * 3);
+		w.write(buf, Mason::encodeBase64(chars, chunk, buf));
+		chars += chunk;
+		n -= chunk;
 	}
 }
 
-void printJSON(const Mason::Value &val, std::ostream &os);
+void printJSON(const Mason::Value &val, Mason::Writer &w);
 
-void printJSONString(const Mason::String &s, std::ostream &os)
+void printJSONString(std::string_view s, Mason::Writer &w)
 {
 	const char *hexAlphabet = "0123456789abcdef";
 
-	os << '"';
-	for (unsigned char ch: s) {
+	w.put('"');
+	while (true) {
+		// Copy everything up to the next character
+		// which might need escaping in one go
+		size_t idx = Mason::unescapedPrefixSize(s);
+		w.write(s.substr(0, idx));
+		if (idx == s.size()) {
+			break;
+		}
+
+		unsigned char ch = s[idx];
+		s.remove_prefix(idx + 1);
 		if (ch == '"' || ch == '\\') {
-			os << "\\" << ch;
+			w.put('\\');
+			w.put(ch);
 		} else if (ch == '\n') {
-			os << "\\n";
+			w.write("\\n");
 		} else if (ch == '\r') {
-			os << "\\r";
+			w.write("\\r");
 		} else if (ch < 0x20) {
-			os << "\\u00";
-			os << hexAlphabet[ch >> 4];
-			os << hexAlphabet[ch & 0x0f];
+			w.write("\\u00");
+			w.put(hexAlphabet[ch >> 4]);
+			w.put(hexAlphabet[ch & 0x0f]);
 		} else {
-			os << ch;
+			w.put(ch);
 		}
 	}
-	os << '"';
+	w.put('"');
 }
 
-void printJSONArray(const Mason::Array &arr, std::ostream &os)
+void printJSONArray(const Mason::Array &arr, Mason::Writer &w)
 {
-	os << '[';
+	w.put('[');
 	bool first = true;
 	for (auto &val: arr) {
 		if (!first) {
-			os << ',';
+			w.put(',');
 		}
 		first = false;
-		printJSON(*val, os);
+		printJSON(*val, w);
 	}
-	os << ']';
+	w.put(']');
 }
 
-void printJSONObject(const Mason::Object &obj, std::ostream &os)
+void printJSONObject(const Mason::Object &obj, Mason::Writer &w)
 {
-	os << '{';
+	w.put('{');
 	bool first = true;
 	for (auto &[k, v]: obj) {
 		if (!first) {
-			os << ',';
+			w.put(',');
 		}
 		first = false;
 
-		printJSONString(k, os);
-		os << ':';
-		printJSON(*v, os);
+		printJSONString(k.str(), w);
+		w.put(':');
+		printJSON(*v, w);
 	}
-	os << '}';
+	w.put('}');
+}
+
+template<typename T>
+void printNumber(T num, Mason::Writer &w)
+{
+	char buf[64];
+	auto res = std::to_chars(buf, &buf[sizeof(buf)], num);
+	w.write(buf, res.ptr - buf);
 }
 
-void printJSON(const Mason::Value &val, std::ostream &os)
+void printJSON(const Mason::Value &val, Mason::Writer &w)
 {
 	if (val.is<Mason::Null>()) {
-		os << "null";
+		w.write("null");
 	} else if (auto *b = val.as<Mason::Bool>(); b) {
-		os << (*b ? "true" : "false");
+		w.write(*b ? "true" : "false");
 	} else if (auto *n = val.as<Mason::Number>(); n) {
-		char buf[64];
-		auto res = std::to_chars(buf, &buf[sizeof(buf) - 1], *n);
-		*res.ptr = '\0';
-		os << buf;
+		printNumber(*n, w);
+	} else if (auto *i = val.as<Mason::Int>(); i) {
+		printNumber(*i, w);
+	} else if (auto *u = val.as<Mason::UInt>(); u) {
+		printNumber(*u, w);
 	} else if (auto *s = val.as<Mason::String>(); s) {
-		printJSONString(*s, os);
+		printJSONString(*s, w);
+	} else if (auto *sv = val.as<Mason::StringView>(); sv && sv->clean) {
+		w.put('"');
+		w.write(*sv);
+		w.put('"');
+	} else if (auto *sv = val.as<Mason::StringView>(); sv) {
+		printJSONString(*sv, w);
 	} else if (auto *bs = val.as<Mason::BString>(); bs) {
-		os << '"';
-		printB64(bs->data(), bs->size(), os);
-		os << '"';
+		w.put('"');
+		printB64(bs->data(), bs->size(), w);
+		w.put('"');
 	} else if (auto *arr = val.as<Mason::Array>(); arr) {
-		printJSONArray(*arr, os);
+		printJSONArray(*arr, w);
 	} else if (auto *obj = val.as<Mason::Object>(); obj) {
-		printJSONObject(*obj, os);
+		printJSONObject(*obj, w);
 	} else {
 		abort();
 	}
 }
 
+// Print each document in a stream of documents as one line of JSON.
+// The documents in a stream tend to share their keys, so they're interned.
+// A stream can go on forever, and a key set which keeps growing is
+// more likely to be IDs than field names, so the table is bounded.
+static int streamToJSON(std::istream &is)
+{
+	Mason::KeyTable keys(4096);
+	Mason::StreamParser parser(is, 100, &keys);
+	Mason::Writer w(1);
+	Mason::Value val;
+	while (parser.next(val)) {
+		printJSON(val, w);
+		w.put('\n');
+	}
+
+	if (!w.flush()) {
+		std::cerr << "Failed to write output\n";
+		return 1;
+	}
+
+	if (!parser.error().empty()) {
+		std::cerr << "Failed to parse: " << parser.error() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
-	std::fstream fstream;
-	std::istream *is;
+	const char *name = argv[0];
+	bool stream = argc >= 2 && std::string_view(argv[1]) == "--stream";
+	if (stream) {
+		argc -= 1;
+		argv += 1;
+	}
 
-	if (argc == 1) {
-		is = &std::cin;
-	} else if (argc == 2) {
-		fstream.open(argv[1]);
-		if (!fstream) {
-			std::cerr << "Failed to open " << argv[1] << '\n';
+	if (argc > 2) {
+		std::cerr << "Usage: " << name << " [--stream] [file]\n";
+		return 1;
+	}
+
+	if (stream) {
+		std::ios::sync_with_stdio(false);
+		if (argc == 1) {
+			return streamToJSON(std::cin);
+		}
+
+		std::ifstream is(argv[1], std::ios::binary);
+		if (!is) {
+			std::cerr << argv[1] << ": Failed to open\n";
 			return 1;
 		}
-		is = &fstream;
-	} else {
-		std::cerr << "Usage: " << argv[0] << " <file>\n";
-		return 1;
+		return streamToJSON(is);
 	}
 
+	// The file is kept open while the value is printed,
+	// so that strings can point into it instead of being copied
 	std::string err;
+	Mason::FileData file;
+	bool ok;
+	if (argc == 1) {
+		ok = file.open(0, &err);
+	} else {
+		ok = file.open(argv[1], &err);
+	}
+
 	Mason::Value val;
-	if (!Mason::parse(*is, val, &err)) {
+	if (ok) {
+		ok = Mason::parseInPlace(file.view(), val, &err);
+	}
+
+	if (!ok) {
 		std::cerr << "Failed to parse: " << err << '\n';
 		return 1;
 	}
 
-	printJSON(val, std::cout);
+	Mason::Writer w(1);
+	printJSON(val, w);
+	if (!w.flush()) {
+		std::cerr << "Failed to write output\n";
+		return 1;
+	}
+
 	return 0;
 }
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mason.h"
+
+namespace Mason {
+
+// A compact binary encoding of values, for passing documents between
+// programs which both use this library. It's much smaller than the
+// text form, and much faster to write and read.
+//
+// An encoded document is the four bytes "MSB\1" followed by one value.
+// Each value is a tag byte followed by its contents:
+//
+//     0x00, 0x01, 0x02  null, false, true
+//     0x03              number, as the 8 bytes of the double
+//     0x04              Int, as a zigzag encoded varint
+//     0x05              UInt, as a varint
+//     0x06, 0x07        string or binary string: the length as a varint,
+//                       then the bytes
+//     0x08              array: the number of elements as a varint,
+//                       then the elements
+//     0x09              object: the number of members as a varint,
+//                       then each member's key and value
+//
+// Varints are LEB128 (7 bits per byte, least significant first),
+// and numbers are little endian.
+// A key is a varint n: if n is even, it's followed by a new key
+// of n / 2 bytes; if it's odd, it's the same as the (n / 2)th new key
+// in the document, so keys which repeat are only written out once.
+// Objects keep their members' order.
+
+// Encode a value, through a Writer from <mason/writer.h>.
+// StringViews are encoded as strings.
+void encodeBinary(Writer &w, const Value &v);
+
+// Decode a value which was encoded with encodeBinary.
+// Object keys can be interned in a KeyTable, as with parse.
+bool decodeBinary(
+	std::string_view data, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "mason.h"
+
+namespace Mason {
+
+// Encoders and decoders for binary data.
+// The encoders write to a buffer which must have room for
+// the encoded size, and return the number of characters written.
+// The decoders append to a BString, and return false if the input
+// isn't valid, in which case some of it may have been appended.
+
+// Base64 with the standard alphabet and '=' padding
+inline size_t base64Size(size_t size) { return (size + 2) / 3 * 4; }
+size_t encodeBase64(const unsigned char *data, size_t size, char *out);
+
+// Lowercase hex, two characters per byte
+inline size_t hexSize(size_t size) { return size * 2; }
+size_t encodeHex(const unsigned char *data, size_t size, char *out);
+bool decodeHex(std::string_view str, BString &out);
+
+// Hex escapes as used in binary string literals, "\xNN" for each byte
+inline size_t hexEscapeSize(size_t size) { return size * 4; }
+size_t encodeHexEscapes(const unsigned char *data, size_t size, char *out);
+
+// Decode the run of hex escapes at the start of a string,
+// stopping at the first thing which isn't one.
+// Returns the number of characters decoded.
+size_t decodeHexEscapes(std::string_view str, BString &out);
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "mason.h"
+
+#include <memory>
+
+namespace Mason {
+
+class Reader;
+
+// A pull parser, which reads a document one token at a time.
+//
+// next() moves to the next token and returns what kind it is.
+// The contents of keys, strings and numbers are only decoded when asked for
+// with one of the read functions; otherwise, the next call to next()
+// skips over them, only looking for where they end.
+// Calling skipValue() on a key, array or object skips everything
+// up to the end of the value in one go, by counting brackets,
+// so nothing inside it is decoded or validated.
+//
+// When reading from a string_view, the string must outlive the cursor.
+// Once an error occurs, next() keeps returning Token::Error,
+// and error() describes what went wrong.
+class Cursor {
+public:
+	enum class Token: unsigned char {
+		None,
+		Null, Bool, Number, String, BString,
+		BeginArray, EndArray,
+		BeginObject, Key, EndObject,
+		End,
+		Error,
+	};
+
+	Cursor(std::istream &is, int maxDepth = 100);
+	Cursor(std::string_view str, int maxDepth = 100);
+	Cursor(const Cursor &) = delete;
+	Cursor &operator=(const Cursor &) = delete;
+	~Cursor();
+
+	Token next();
+	Token token() const { return token_; }
+
+	// The number of arrays and objects the current token is in
+	size_t depth() const { return frames_.size(); }
+
+	// Read the current token. They return false if the token
+	// is of a different type, without putting the cursor in the error state.
+	// Strings and keys are valid until the next call to a Cursor function.
+	bool readKey(std::string_view &key);
+	bool readString(std::string_view &str);
+	bool readBString(BString &bytes);
+	bool readBool(Bool &b);
+
+	// Integers are converted to Number
+	bool readNumber(Number &num);
+
+	// These only succeed if the number is an integer
+	// which fits in the given type
+	bool readInt(Int &num);
+	bool readUInt(UInt &num);
+
+	// Skip the rest of the current value, so that next()
+	// moves on to whatever comes after it.
+	// For a key, that means the key and its value;
+	// for the start of an array or object, the whole array or object.
+	bool skipValue();
+
+	const std::string &error() const { return err_; }
+
+private:
+	friend class PushParser;
+
+	struct Frame {
+		enum State {
+			First, Value, AfterValue,
+		};
+
+		// '[' for arrays, '{' for objects and 't' for the
+		// top-level object without braces
+		char kind;
+		State state;
+
+		// Whether the current value is followed by a separator;
+		// a multi-line string counts as having one
+		bool hasSep;
+	};
+
+	bool finishToken();
+	bool finishKey();
+	bool readNumberToken();
+	Token findToken();
+	Token findValue(bool topLevel);
+	bool valueDone();
+	Token fail();
+
+	std::unique_ptr<Reader> reader_;
+	int maxDepth_;
+	std::vector<Frame> frames_;
+	bool rootDone_ = false;
+
+	Token token_ = Token::None;
+
+	// Whether the current token has been read from the input;
+	// keywords and top-level keys are read as soon as they're found,
+	// the rest only when asked for
+	bool consumed_ = false;
+
+	// Whether the current token has been finished by skipValue()
+	bool done_ = false;
+
+	Bool bool_ = false;
+	Type numType_ = Type::Number;
+	Number number_ = 0;
+	Int int_ = 0;
+	UInt uint_ = 0;
+
+	std::string buffer_;
+	BString bytes_;
+	std::string err_;
+};
+
+}
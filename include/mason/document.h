@@ -0,0 +1,176 @@
+#pragma once
+
+#include "mason.h"
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace Mason {
+
+// Memory which is handed out from large blocks and freed all at once.
+class Arena {
+public:
+	Arena() = default;
+	Arena(Arena &&other);
+	Arena &operator=(Arena &&other);
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+	~Arena();
+
+	void *alloc(size_t size, size_t align = alignof(std::max_align_t))
+	{
+		uintptr_t ptr = (uintptr_t(cur_) + align - 1) & ~uintptr_t(align - 1);
+		if (ptr + size > uintptr_t(end_)) {
+			return allocBlock(size, align);
+		}
+
+		cur_ = (char *)(ptr + size);
+		return (void *)ptr;
+	}
+
+	template<typename T>
+	T *alloc(size_t count)
+	{
+		return (T *)alloc(sizeof(T) * count, alignof(T));
+	}
+
+	// Free everything. The most recent block is kept around for reuse.
+	void clear();
+
+private:
+	struct Block {
+		Block *next;
+		size_t size;
+	};
+
+	void *allocBlock(size_t size, size_t align);
+
+	char *cur_ = nullptr;
+	char *end_ = nullptr;
+	Block *blocks_ = nullptr;
+	size_t nextSize_ = 4096;
+};
+
+struct Member;
+
+// A value in a Document.
+// All memory referenced by a node is owned by the document's arena,
+// so a node is only valid for as long as its document.
+class Node {
+public:
+	using Type = Mason::Type;
+
+	Type type() const { return type_; }
+
+	bool isNull() const { return type_ == Type::Null; }
+	bool isBool() const { return type_ == Type::Bool; }
+	bool isNumber() const { return type_ == Type::Number; }
+	bool isInt() const { return type_ == Type::Int; }
+	bool isUInt() const { return type_ == Type::UInt; }
+	bool isString() const { return type_ == Type::String; }
+	bool isBString() const { return type_ == Type::BString; }
+	bool isArray() const { return type_ == Type::Array; }
+	bool isObject() const { return type_ == Type::Object; }
+
+	// The accessors return false, 0 or an empty string
+	// if the node is of a different type,
+	// except that number() also converts integers
+	Bool boolean() const { return isBool() ? b_ : false; }
+	Int integer() const { return isInt() ? int_ : 0; }
+	UInt uinteger() const { return isUInt() ? uint_ : 0; }
+
+	Number number() const
+	{
+		switch (type_) {
+		case Type::Number: return num_;
+		case Type::Int: return Number(int_);
+		case Type::UInt: return Number(uint_);
+		default: return 0;
+		}
+	}
+
+	std::string_view string() const
+	{
+		if (!isString()) {
+			return {};
+		}
+
+		return {(const char *)data_.ptr, data_.size};
+	}
+
+	const unsigned char *bytes() const
+	{
+		return isBString() ? (const unsigned char *)data_.ptr : nullptr;
+	}
+
+	// The number of bytes, elements or members
+	// for strings, arrays and objects respectively
+	size_t size() const { return type_ >= Type::String ? data_.size : 0; }
+
+	// Array elements
+	const Node *begin() const { return isArray() ? items() : nullptr; }
+	const Node *end() const { return isArray() ? items() + size() : nullptr; }
+	const Node &operator[](size_t index) const { return items()[index]; }
+
+	// Object members, in the order they appeared in the document
+	const Member *members() const
+	{
+		return isObject() ? (const Member *)data_.ptr : nullptr;
+	}
+
+	// Look up a key in an object. If the key appears more than once,
+	// the last one wins. Returns nullptr if the key doesn't exist.
+	const Node *find(std::string_view key) const;
+
+private:
+	friend class DocumentBuilder;
+
+	const Node *items() const { return (const Node *)data_.ptr; }
+
+	Type type_ = Type::Null;
+	union {
+		Bool b_;
+		Number num_;
+		Int int_;
+		UInt uint_;
+		struct {
+			const void *ptr;
+			size_t size;
+		} data_ = {nullptr, 0};
+	};
+};
+
+struct Member {
+	std::string_view key;
+	Node value;
+};
+
+// A read-only document where every node, string and child list
+// lives in an arena, so building it doesn't need one allocation per node
+// and destroying it frees a handful of large blocks.
+class Document {
+public:
+	const Node &root() const { return root_; }
+
+	void clear()
+	{
+		arena_.clear();
+		root_ = Node();
+	}
+
+private:
+	friend class DocumentBuilder;
+
+	Arena arena_;
+	Node root_;
+};
+
+bool parse(
+	std::istream &is, Document &doc,
+	std::string *err = nullptr, int maxDepth = 100);
+
+bool parse(
+	std::string_view str, Document &doc,
+	std::string *err = nullptr, int maxDepth = 100);
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "mason.h"
+
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace Mason {
+
+// A table of interned object keys, shared between parses of documents
+// which use the same keys over and over again.
+// Each distinct key is stored once, with its hash and whether it's
+// a bare identifier worked out when it's added.
+// Objects refer to the keys in the table, so it must outlive them.
+// The table can be used by several threads at once.
+class KeyTable {
+public:
+	KeyTable() = default;
+
+	// A table which stops growing once it holds maxSize keys.
+	// Useful for long-running streams, where keys such as IDs
+	// would otherwise make it grow without bound.
+	explicit KeyTable(size_t maxSize): maxSize_(maxSize) {}
+
+	// Get the interned key for a string, adding it if it's new.
+	// Returns null for a new key if the table is full;
+	// the key then has to hold its own string.
+	const KeyData *intern(std::string_view str);
+
+	size_t size() const;
+
+private:
+	size_t maxSize_ = SIZE_MAX;
+	mutable std::shared_mutex mutex_;
+	std::deque<KeyData> keys_;
+	std::unordered_map<std::string_view, const KeyData *, StringHash> index_;
+};
+
+}
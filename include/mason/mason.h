@@ -1,17 +1,22 @@
 #pragma once
 
 #include <functional>
+#include <initializer_list>
 #include <string_view>
 #include <variant>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <unordered_map>
 #include <iosfwd>
+#include <stdint.h>
 
 namespace Mason {
 
 class Value;
+class KeyTable;
+class Writer;
 
 struct StringHash {
 	using hash_type = std::hash<std::string_view>;
@@ -22,29 +27,231 @@ struct StringHash {
 	std::size_t operator()(const std::string &str) const { return hash_type{}(str); }
 };
 
+// The kinds of values a document can contain
+enum class Type: unsigned char {
+	Null, Bool, Number, Int, UInt, String, BString, Array, Object,
+};
+
 struct Null {};
 using Bool = bool;
 using Number = double;
+
+// Number literals without a fraction or exponent which fit in 64 bits
+// are integers. UInt is only used for values too big for an Int.
+using Int = int64_t;
+using UInt = uint64_t;
 using String = std::string;
 using BString = std::vector<unsigned char>;
+
+// A string which points into the input it was parsed from,
+// as produced by parseInPlace
+struct StringView: std::string_view {
+	explicit StringView(std::string_view str, bool clean = false):
+		std::string_view(str), clean(clean) {}
+
+	// Whether the string is known to not contain anything
+	// which has to be escaped when it's serialized
+	bool clean;
+};
+
 using Array = std::vector<std::shared_ptr<Value>>;
-using Object = std::unordered_map<
-	std::string, std::shared_ptr<Value>,
-	StringHash, std::equal_to<>>;
+
+// An object key which has been interned in a KeyTable.
+// Its hash, and whether it can be written without quotes,
+// are worked out once when it's added to the table.
+struct KeyData {
+	std::string str;
+	uint64_t hash;
+	bool bare;
+};
+
+// Whether a key is an identifier which can be written without quotes
+bool isBareKey(std::string_view key);
+
+// An object key. It either holds its own string, or refers to
+// a KeyData in a KeyTable, which must then outlive the key.
+class Key {
+	template<typename S>
+	using IfString = std::enable_if_t<
+		std::is_convertible_v<const S &, std::string_view> &&
+		!std::is_same_v<S, Key>>;
+
+public:
+	Key() = default;
+	Key(std::string str): str_(std::move(str)) {}
+	Key(std::string_view str): str_(str) {}
+	Key(const char *str): str_(str) {}
+	Key(const KeyData *data): data_(data) {}
+
+	const std::string &str() const { return data_ ? data_->str : str_; }
+	operator const std::string &() const { return str(); }
+
+	// The interned key, or null if the key holds its own string
+	const KeyData *interned() const { return data_; }
+
+	uint64_t hash() const
+	{
+		return data_ ? data_->hash : StringHash{}(str_);
+	}
+
+	bool bare() const { return data_ ? data_->bare : isBareKey(str_); }
+
+	friend bool operator==(const Key &a, const Key &b)
+	{
+		return (a.data_ && a.data_ == b.data_) || a.str() == b.str();
+	}
+
+	friend bool operator!=(const Key &a, const Key &b) { return !(a == b); }
+
+	// Keys compare with anything which converts to a string_view,
+	// such as string literals and std::strings
+	template<typename S, typename = IfString<S>>
+	friend bool operator==(const Key &a, const S &b)
+	{
+		return a.str() == std::string_view(b);
+	}
+
+	template<typename S, typename = IfString<S>>
+	friend bool operator==(const S &a, const Key &b) { return b == a; }
+
+	template<typename S, typename = IfString<S>>
+	friend bool operator!=(const Key &a, const S &b) { return !(a == b); }
+
+	template<typename S, typename = IfString<S>>
+	friend bool operator!=(const S &a, const Key &b) { return !(b == a); }
+
+private:
+	friend class ValueBuilder;
+
+	const KeyData *data_ = nullptr;
+	std::string str_;
+};
+
+// An object's members, in the order they were inserted.
+// They're stored contiguously; small objects are searched linearly,
+// and larger ones also keep a compact hash index of their keys.
+// Keys must not be modified through an iterator.
+class Object {
+public:
+	using key_type = Key;
+	using mapped_type = std::shared_ptr<Value>;
+	using value_type = std::pair<Key, std::shared_ptr<Value>>;
+	using iterator = std::vector<value_type>::iterator;
+	using const_iterator = std::vector<value_type>::const_iterator;
+
+	Object() = default;
+	Object(std::initializer_list<value_type> init);
+
+	iterator begin() { return entries_.begin(); }
+	iterator end() { return entries_.end(); }
+	const_iterator begin() const { return entries_.begin(); }
+	const_iterator end() const { return entries_.end(); }
+
+	size_t size() const { return entries_.size(); }
+	bool empty() const { return entries_.empty(); }
+
+	void reserve(size_t n);
+	void clear() { entries_.clear(); slots_.clear(); }
+
+	iterator find(std::string_view key) { return begin() + indexOf(key); }
+
+	const_iterator find(std::string_view key) const
+	{
+		return begin() + indexOf(key);
+	}
+
+	size_t count(std::string_view key) const { return indexOf(key) != size(); }
+
+	// Get the value for a key, adding a null pointer for it
+	// at the end if it's not there
+	mapped_type &operator[](std::string_view key);
+
+	// Get the value for a key, throwing std::out_of_range
+	// if it's not there
+	mapped_type &at(std::string_view key);
+	const mapped_type &at(std::string_view key) const;
+
+	// Add a member at the end, unless the key is already there,
+	// in which case the entry is left untouched.
+	// Returns the member with the key, and whether it was added.
+	std::pair<iterator, bool> insert(value_type &&entry);
+
+	std::pair<iterator, bool> insert(const value_type &entry)
+	{
+		return insert(value_type(entry));
+	}
+
+	std::pair<iterator, bool> emplace(Key key, mapped_type val)
+	{
+		return insert(value_type(std::move(key), std::move(val)));
+	}
+
+	// Erasing a member moves the ones after it,
+	// so it takes linear time
+	iterator erase(const_iterator pos);
+	size_t erase(std::string_view key);
+
+private:
+	// Objects with more members than this get a hash index
+	static constexpr size_t indexedSize = 8;
+
+	// A slot in the hash index: the position of the member plus one
+	// (0 for an empty slot), and some bits of its key's hash
+	struct Slot {
+		uint32_t entry;
+		uint32_t hash;
+	};
+
+	size_t indexOf(std::string_view key) const;
+
+	template<typename K>
+	size_t linearIndexOf(const K &key) const;
+
+	template<typename K>
+	size_t hashedIndexOf(const K &key, uint64_t hash) const;
+
+	void addSlot(size_t entry, uint64_t hash);
+	void rebuildIndex(size_t n);
+
+	std::vector<value_type> entries_;
+	std::vector<Slot> slots_;
+};
 
 class Value {
+	// A value from parseLazy which hasn't been decoded yet
+	struct Lazy;
+	using LazyPtr = std::shared_ptr<const Lazy>;
+
 public:
-	using V = std::variant<Null, Bool, Number, String, BString, Array, Object>;
+	using V = std::variant<
+		Null, Bool, Number, Int, UInt, String, BString, Array, Object,
+		StringView, LazyPtr>;
 
 	Value(): Value(Null{}) {}
 	template<typename T>
 	Value(T v): v_(std::move(v)) {}
 
+	// Copying a value from parseLazy decodes it first,
+	// so that the copy doesn't share anything with it
+	Value(const Value &other): v_(other.get()) {}
+	Value(Value &&other) = default;
+
+	Value &operator=(const Value &other)
+	{
+		V v = other.get();
+		v_ = std::move(v);
+		return *this;
+	}
+
+	Value &operator=(Value &&other) = default;
+
+	// A value from parseLazy which turns out to be invalid
+	// reads as null; see load.
 	template<typename T>
-	T *as() { return std::get_if<T>(&v_); }
+	T *as() { return std::get_if<T>(&v()); }
 
 	template<typename T>
-	const T *as() const { return std::get_if<T>(&v_); }
+	const T *as() const { return std::get_if<T>(&get()); }
 
 	template<typename T>
 	bool is() const { return as<T>(); }
@@ -63,17 +270,39 @@ public:
 	Null &set(Null &&v) { return setT(std::move(v)); }
 	Bool &set(Bool &&v) { return setT(std::move(v)); }
 	Number &set(Number &&v) { return setT(std::move(v)); }
+	Int &set(Int &&v) { return setT(std::move(v)); }
+	UInt &set(UInt &&v) { return setT(std::move(v)); }
 	String &set(String &&v) { return setT(std::move(v)); }
 	BString &set(BString &&v) { return setT(std::move(v)); }
 	Array &set(Array &&v) { return setT(std::move(v)); }
 	Object &set(Object &&v) { return setT(std::move(v)); }
+	StringView &set(StringView &&v) { return setT(std::move(v)); }
 
-	V &v() { return v_; }
+	V &v() { return isLazy() ? lazyValue() : v_; }
 
-	void index(size_t index) { index_ = index; }
-	size_t index() { return index_; }
+	// Decode the value, if it came from parseLazy and hasn't been
+	// accessed yet. This happens automatically on access;
+	// calling it directly is only needed to find out about errors.
+	// An invalid value is left as null, and every call to load
+	// reports the same error.
+	// A value is only decoded once, even if several threads
+	// read it at the same time. The decoded value is kept along with
+	// where it was in the input, until the value is set to something else.
+	bool load(std::string *err = nullptr) const
+	{
+		return !isLazy() || loadLazy(err);
+	}
 
 private:
+	friend class ValueBuilder;
+
+	bool isLazy() const { return std::holds_alternative<LazyPtr>(v_); }
+
+	const V &get() const { return isLazy() ? lazyValue() : v_; }
+
+	bool loadLazy(std::string *err) const;
+	V &lazyValue() const;
+
 	template<typename T>
 	T &setT(T &&v)
 	{
@@ -82,13 +311,187 @@ private:
 	}
 
 	V v_;
-	size_t index_ = ~size_t(0);
 };
 
+// Receives the contents of a document as it's being parsed,
+// without building a tree.
+// Strings are only valid until the callback returns.
+// Returning false from a callback stops parsing with an error.
+class Handler {
+public:
+	virtual ~Handler() = default;
+
+	virtual bool onNull() { return true; }
+	virtual bool onBool(Bool) { return true; }
+	virtual bool onNumber(Number) { return true; }
+	virtual bool onInt(Int) { return true; }
+	virtual bool onUInt(UInt) { return true; }
+	virtual bool onString(std::string_view) { return true; }
+	virtual bool onBString(const unsigned char *, size_t) { return true; }
+	virtual bool onBeginArray() { return true; }
+	virtual bool onEndArray() { return true; }
+	virtual bool onBeginObject() { return true; }
+	virtual bool onKey(std::string_view) { return true; }
+	virtual bool onEndObject() { return true; }
+};
+
+// The contents of a file, kept in memory for as long as the FileData lives.
+// Regular files are memory mapped; pipes, terminals and the like
+// are read into a buffer instead.
+class FileData {
+public:
+	FileData() = default;
+	FileData(FileData &&other);
+	FileData &operator=(FileData &&other);
+	FileData(const FileData &) = delete;
+	FileData &operator=(const FileData &) = delete;
+	~FileData();
+
+	bool open(const char *path, std::string *err = nullptr);
+
+	// Read from an already open file descriptor, such as stdin.
+	// The file descriptor is not closed.
+	bool open(int fd, std::string *err = nullptr);
+
+	void close();
+
+	const char *data() const { return data_; }
+	size_t size() const { return size_; }
+	std::string_view view() const { return {data_, size_}; }
+
+private:
+	const char *data_ = "";
+	size_t size_ = 0;
+	bool mapped_ = false;
+	std::string buffer_;
+};
+
+// Parse a document into a value.
+// Object keys can be interned in a KeyTable from <mason/keys.h>,
+// which must then outlive the value.
 bool parse(
 	std::istream &is, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+// Parse a document which is already in memory.
+// The buffer is read in place and doesn't need to be null terminated.
+bool parse(
+	std::string_view str, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+bool parse(
+	const char *data, size_t size, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+// Parse a document which is in memory, after a first pass over it
+// which counts the elements of every array and object,
+// so that they can be allocated at their final size up front.
+// This pays off for documents with large arrays and objects;
+// for ones made of many small records, it's only extra work.
+bool parseIndexed(
+	std::string_view str, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+// Parse a document which is in memory, without copying strings out of it.
+// Quoted strings without escapes and raw strings become StringViews
+// which point into the input, so it must outlive the value;
+// other strings are decoded into Strings as usual.
+bool parseInPlace(
+	std::string_view str, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+// Parse a document lazily: only the top-level value is decoded,
+// and for everything inside it, only the position in the input is recorded.
+// Nested values are decoded the first time they're accessed,
+// so the input must outlive the value.
+// Values inside the top-level value are only checked for where they end,
+// so errors in them are found when they're decoded; see Value::load.
+bool parseLazy(
+	std::string_view str, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+// Parse a document using several threads.
+// The elements of the top-level array or object are located first,
+// by skipping over them without decoding them,
+// and then parsed in parallel.
+// A thread count of 0 means one thread per core.
+bool parseParallel(
+	std::string_view str, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	unsigned threads = 0, KeyTable *keys = nullptr);
+
+class Reader;
+class ValueBuilder;
+
+// Parses a sequence of documents from one input,
+// such as a log with one record per line.
+// Documents may be separated by whitespace and comments.
+// Objects at the top level need braces, since a top-level key
+// would otherwise take the rest of the input as its object.
+class StreamParser {
+public:
+	StreamParser(
+		std::istream &is, int maxDepth = 100, KeyTable *keys = nullptr);
+	StreamParser(
+		std::string_view str, int maxDepth = 100, KeyTable *keys = nullptr);
+	StreamParser(const StreamParser &) = delete;
+	StreamParser &operator=(const StreamParser &) = delete;
+	~StreamParser();
+
+	// Parse the next document into v.
+	// The memory v already holds is reused where possible,
+	// so it's fastest to pass the same Value every time.
+	// Returns false at the end of the input or on error;
+	// error() is only set in the second case.
+	bool next(Value &v);
+
+	const std::string &error() const { return err_; }
+
+private:
+	std::unique_ptr<Reader> reader_;
+	std::unique_ptr<ValueBuilder> builder_;
+	int maxDepth_;
+	KeyTable *keys_;
+	std::string err_;
+};
+
+// Parse a document, passing its contents to a handler.
+// Memory use doesn't grow with the size of the document.
+bool parse(
+	std::istream &is, Handler &h,
 	std::string *err = nullptr, int maxDepth = 100);
 
+bool parse(
+	std::string_view str, Handler &h,
+	std::string *err = nullptr, int maxDepth = 100);
+
+// Parse a file, memory mapping it if possible.
+bool parseFile(
+	const char *path, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
+bool parseFile(
+	int fd, Value &v,
+	std::string *err = nullptr, int maxDepth = 100,
+	KeyTable *keys = nullptr);
+
 void serialize(std::ostream &os, Value &v);
 
+// Serialize through a Writer from <mason/writer.h>,
+// which is much faster than going through an std::ostream
+void serialize(Writer &w, Value &v);
+
+// Serialize using several threads.
+// Large arrays and objects are split into ranges of elements,
+// which are serialized in parallel and written out in order.
+// A thread count of 0 means one thread per core.
+void serializeParallel(Writer &w, Value &v, unsigned threads = 0);
+
 }
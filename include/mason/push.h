@@ -0,0 +1,51 @@
+#pragma once
+
+#include "cursor.h"
+
+namespace Mason {
+
+// A parser which is given the input a piece at a time,
+// for when the document arrives in chunks, such as from a socket.
+// The contents of the document are passed to a Handler as soon as
+// they're complete; only the bytes of a token which is split between
+// chunks are kept around until the rest of it arrives.
+class PushParser {
+public:
+	PushParser(Handler &h, int maxDepth = 100);
+
+	// Parse the next piece of the document.
+	// Returns false if there's an error.
+	bool feed(const char *data, size_t size);
+
+	bool feed(std::string_view str) { return feed(str.data(), str.size()); }
+
+	// Signal that there's no more input.
+	// Returns true if the document was complete and valid.
+	bool finish();
+
+	// Whether finish() has successfully parsed the whole document
+	bool done() const { return done_; }
+
+	const std::string &error() const { return cursor_.error(); }
+
+private:
+	bool run(bool final);
+
+	Handler &h_;
+	Cursor cursor_;
+
+	// Input which has been fed but not parsed yet,
+	// starting at offset base_ in the document
+	std::string pending_;
+	size_t base_ = 0;
+
+	// Don't try again to parse an incomplete token
+	// until this much input is available, so that a long token
+	// which arrives in small pieces isn't re-parsed for each piece
+	size_t retryAt_ = 0;
+
+	bool done_ = false;
+	bool failed_ = false;
+};
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "tape.h"
+
+namespace Mason {
+
+// A document frozen in a file, which can be memory mapped and read
+// in place without being decoded.
+// The file holds a small header followed by the words and strings
+// of a Tape, which only refer to each other by offset.
+// Opening a snapshot only maps the file, so processes which open
+// the same snapshot share its pages.
+// Snapshots are only readable on machines with the same byte order
+// as the one which wrote them.
+class Snapshot {
+public:
+	// The file's header is checked, but not the tape itself,
+	// so only snapshots written by writeSnapshot should be opened
+	bool open(const char *path, std::string *err = nullptr);
+	bool open(int fd, std::string *err = nullptr);
+
+	void close();
+
+	// The root of the document, which is valid until the snapshot
+	// is closed or destroyed
+	TapeRef root() const;
+
+private:
+	bool load(std::string *err);
+
+	FileData file_;
+	const uint64_t *words_ = nullptr;
+	const char *strings_ = nullptr;
+};
+
+// Write a tape, or a value converted to a tape, as a snapshot,
+// through a Writer from <mason/writer.h>
+void writeSnapshot(Writer &w, const Tape &tape);
+void writeSnapshot(Writer &w, const Value &v);
+
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "mason.h"
+
+#include <stdint.h>
+
+namespace Mason {
+
+// A parsed document laid out as one flat array of 64-bit words,
+// plus a side buffer holding the bytes of every string.
+// Each word has an 8-bit tag in the top byte and a 56-bit payload:
+//
+//     'n', 't', 'f'  null, true, false
+//     'd'            number, followed by a word with the double's bits
+//     'l', 'u'       Int or UInt, followed by a word with the integer
+//     '"', 'b'       string or binary string; the payload is the offset
+//                    into the string buffer, followed by a word with the length
+//     '[', '{'       start of array or object; the payload is the index
+//                    of the matching end word, followed by a word with
+//                    the number of elements or members
+//     ']', '}'       end of array or object; the payload is the index
+//                    of the matching start word
+//
+// Object members are stored as a key string followed by the value.
+class TapeIterator;
+class TapeMembers;
+
+class TapeRef {
+public:
+	TapeRef() = default;
+	TapeRef(const uint64_t *tape, const char *strings, size_t index):
+		tape_(tape), strings_(strings), index_(index) {}
+
+	Type type() const;
+
+	bool isNull() const { return tag() == 'n'; }
+	bool isBool() const { return tag() == 't' || tag() == 'f'; }
+	bool isNumber() const { return tag() == 'd'; }
+	bool isInt() const { return tag() == 'l'; }
+	bool isUInt() const { return tag() == 'u'; }
+	bool isString() const { return tag() == '"'; }
+	bool isBString() const { return tag() == 'b'; }
+	bool isArray() const { return tag() == '['; }
+	bool isObject() const { return tag() == '{'; }
+
+	// The accessors return false, 0 or an empty string
+	// if the value is of a different type,
+	// except that number() also converts integers
+	Bool boolean() const { return tag() == 't'; }
+	Number number() const;
+	Int integer() const { return isInt() ? Int(word(1)) : 0; }
+	UInt uinteger() const { return isUInt() ? word(1) : 0; }
+	std::string_view string() const;
+	const unsigned char *bytes() const;
+
+	// The number of bytes, elements or members
+	// for strings, arrays and objects respectively
+	size_t size() const;
+
+	// Index into an array; walks past the preceding elements
+	TapeRef operator[](size_t index) const;
+
+	// Look up a key in an object. If the key appears more than once,
+	// the last one wins. Returns a null TapeRef if the key doesn't exist.
+	TapeRef find(std::string_view key) const;
+
+	// True if this refers to a value, as opposed to a failed lookup
+	explicit operator bool() const { return tape_ != nullptr; }
+
+	// The index of the word after this value
+	size_t next() const;
+
+	size_t index() const { return index_; }
+
+	// Array elements
+	TapeIterator begin() const;
+	TapeIterator end() const;
+
+	// Object members, in the order they appeared in the document
+	TapeMembers members() const;
+
+private:
+	friend class TapeIterator;
+	friend class TapeMemberIterator;
+
+	uint64_t word(size_t offset = 0) const { return tape_[index_ + offset]; }
+	char tag() const { return tape_ ? char(word() >> 56) : 'n'; }
+	uint64_t payload() const { return word() & ((uint64_t(1) << 56) - 1); }
+
+	const uint64_t *tape_ = nullptr;
+	const char *strings_ = nullptr;
+	size_t index_ = 0;
+};
+
+class TapeIterator {
+public:
+	TapeIterator(TapeRef ref): ref_(ref) {}
+
+	TapeRef operator*() const { return ref_; }
+
+	TapeIterator &operator++()
+	{
+		ref_.index_ = ref_.next();
+		return *this;
+	}
+
+	bool operator!=(const TapeIterator &other) const
+	{
+		return ref_.index_ != other.ref_.index_;
+	}
+
+private:
+	TapeRef ref_;
+};
+
+struct TapeMember {
+	std::string_view key;
+	TapeRef value;
+};
+
+class TapeMemberIterator {
+public:
+	TapeMemberIterator(TapeRef key): key_(key) {}
+
+	TapeMember operator*() const
+	{
+		return {key_.string(), value()};
+	}
+
+	TapeMemberIterator &operator++()
+	{
+		key_.index_ = value().next();
+		return *this;
+	}
+
+	bool operator!=(const TapeMemberIterator &other) const
+	{
+		return key_.index_ != other.key_.index_;
+	}
+
+private:
+	TapeRef value() const { return {key_.tape_, key_.strings_, key_.next()}; }
+
+	TapeRef key_;
+};
+
+class TapeMembers {
+public:
+	TapeMembers(TapeRef first, TapeRef last): first_(first), last_(last) {}
+
+	TapeMemberIterator begin() const { return first_; }
+	TapeMemberIterator end() const { return last_; }
+
+private:
+	TapeRef first_;
+	TapeRef last_;
+};
+
+class Tape {
+public:
+	TapeRef root() const
+	{
+		if (words_.empty()) {
+			return {};
+		}
+
+		return {words_.data(), strings_.data(), 0};
+	}
+
+	const std::vector<uint64_t> &words() const { return words_; }
+	const std::string &strings() const { return strings_; }
+
+	void clear()
+	{
+		words_.clear();
+		strings_.clear();
+	}
+
+private:
+	friend class TapeBuilder;
+
+	std::vector<uint64_t> words_;
+	std::string strings_;
+};
+
+bool parse(
+	std::istream &is, Tape &tape,
+	std::string *err = nullptr, int maxDepth = 100);
+
+bool parse(
+	std::string_view str, Tape &tape,
+	std::string *err = nullptr, int maxDepth = 100);
+
+// Build a tape holding the same document as a value
+void buildTape(const Value &v, Tape &tape);
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "mason.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace Mason {
+
+// Collects output in a buffer and writes it out in large blocks,
+// to a string, a file descriptor, a FILE * or an std::ostream.
+// Whatever is left in the buffer is written when the writer is destroyed.
+class Writer {
+public:
+	Writer(std::string &str);
+	Writer(int fd);
+	Writer(FILE *f);
+	Writer(std::ostream &os);
+	Writer(const Writer &) = delete;
+	Writer &operator=(const Writer &) = delete;
+	~Writer();
+
+	void put(char ch)
+	{
+		if (size_ == sizeof(buffer_)) {
+			drain();
+		}
+		buffer_[size_++] = ch;
+	}
+
+	void write(const char *data, size_t size)
+	{
+		if (size <= sizeof(buffer_) - size_) {
+			memcpy(buffer_ + size_, data, size);
+			size_ += size;
+		} else {
+			writeSlow(data, size);
+		}
+	}
+
+	void write(std::string_view str) { write(str.data(), str.size()); }
+
+	// Write out everything in the buffer.
+	// Returns false if any write so far has failed.
+	bool flush();
+
+	bool ok() const { return ok_; }
+
+private:
+	enum class Kind {
+		String, Fd, File, Stream,
+	};
+
+	void drain();
+	void writeSlow(const char *data, size_t size);
+	void output(const char *data, size_t size);
+
+	Kind kind_;
+	std::string *str_ = nullptr;
+	int fd_ = -1;
+	FILE *file_ = nullptr;
+	std::ostream *os_ = nullptr;
+	bool ok_ = true;
+
+	size_t size_ = 0;
+	char buffer_[64 * 1024];
+};
+
+// The number of characters at the start of a string which can be
+// written between double quotes without escaping, in MASON or JSON.
+// This is everything up to the first '"', '\\' or control character.
+// Useful for writing strings in other formats with a Writer,
+// by copying the parts which don't need escaping in one go.
+size_t unescapedPrefixSize(std::string_view str);
+
+}
@@ -0,0 +1,400 @@
+#include "binary.h"
+#include "keys.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Mason {
+
+static const char binaryMagic[] = {'M', 'S', 'B', 1};
+
+enum BinaryTag: unsigned char {
+	TagNull, TagFalse, TagTrue, TagNumber, TagInt, TagUInt,
+	TagString, TagBString, TagArray, TagObject,
+};
+
+class BinaryEncoder {
+public:
+	BinaryEncoder(Writer &w): w_(w) {}
+
+	void value(const Value &v) {
+		if (v.is<Null>()) {
+			w_.put(TagNull);
+		} else if (auto *b = v.as<Bool>(); b) {
+			w_.put(*b ? TagTrue : TagFalse);
+		} else if (auto *n = v.as<Number>(); n) {
+			uint64_t bits;
+			memcpy(&bits, n, sizeof(bits));
+			char buf[9] = {TagNumber};
+			for (int i = 0; i < 8; ++i) {
+				buf[i + 1] = char(bits >> (i * 8));
+			}
+			w_.write(buf, sizeof(buf));
+		} else if (auto *i = v.as<Int>(); i) {
+			// Zigzag, so that small negative numbers are short too
+			header(TagInt, (uint64_t(*i) << 1) ^ uint64_t(*i >> 63));
+		} else if (auto *u = v.as<UInt>(); u) {
+			header(TagUInt, *u);
+		} else if (auto *s = v.as<String>(); s) {
+			header(TagString, s->size());
+			w_.write(*s);
+		} else if (auto *sv = v.as<StringView>(); sv) {
+			header(TagString, sv->size());
+			w_.write(*sv);
+		} else if (auto *bs = v.as<BString>(); bs) {
+			header(TagBString, bs->size());
+			w_.write((const char *)bs->data(), bs->size());
+		} else if (auto *arr = v.as<Array>(); arr) {
+			header(TagArray, arr->size());
+			for (auto &val: *arr) {
+				value(*val);
+			}
+		} else if (auto *obj = v.as<Object>(); obj) {
+			header(TagObject, obj->size());
+			for (auto &[key, val]: *obj) {
+				this->key(key);
+				value(*val);
+			}
+		}
+	}
+
+private:
+	// A tag followed by a varint
+	void header(unsigned char tag, uint64_t num) {
+		char buf[11];
+		buf[0] = tag;
+		w_.write(buf, 1 + varint(buf + 1, num));
+	}
+
+	void key(const Key &key) {
+		char buf[10];
+		uint64_t id;
+		if (findKey(key, id)) {
+			w_.write(buf, varint(buf, id << 1 | 1));
+			return;
+		}
+
+		const std::string &str = key.str();
+		w_.write(buf, varint(buf, uint64_t(str.size()) << 1));
+		w_.write(str);
+	}
+
+	// Look up the ID of a key which has already been written out,
+	// or give it the next ID if it hasn't
+	bool findKey(const Key &key, uint64_t &id) {
+		if ((count_ + 1) * 2 > slots_.size()) {
+			growKeys();
+		}
+
+		uint64_t hash = key.hash();
+		size_t mask = slots_.size() - 1;
+		for (size_t i = hash & mask;; i = (i + 1) & mask) {
+			KeySlot &slot = slots_[i];
+			if (!slot.str) {
+				slot = {&key.str(), hash, count_};
+				id = count_++;
+				return false;
+			}
+
+			if (slot.hash == hash && *slot.str == key.str()) {
+				id = slot.id;
+				return true;
+			}
+		}
+	}
+
+	void growKeys() {
+		std::vector<KeySlot> old = std::move(slots_);
+		slots_.assign(std::max<size_t>(old.size() * 2, 64), KeySlot{});
+		size_t mask = slots_.size() - 1;
+		for (auto &slot: old) {
+			if (!slot.str) {
+				continue;
+			}
+
+			size_t i = slot.hash & mask;
+			while (slots_[i].str) {
+				i = (i + 1) & mask;
+			}
+			slots_[i] = slot;
+		}
+	}
+
+	static size_t varint(char *buf, uint64_t num) {
+		size_t len = 0;
+		while (num >= 0x80) {
+			buf[len++] = char(num | 0x80);
+			num >>= 7;
+		}
+		buf[len++] = char(num);
+		return len;
+	}
+
+	Writer &w_;
+
+	// A hash table of the keys which have been written out and their IDs,
+	// pointing into the value being encoded
+	struct KeySlot {
+		const std::string *str = nullptr;
+		uint64_t hash;
+		uint64_t id;
+	};
+
+	std::vector<KeySlot> slots_;
+	size_t count_ = 0;
+};
+
+void encodeBinary(Writer &w, const Value &v)
+{
+	w.write(binaryMagic, sizeof(binaryMagic));
+	BinaryEncoder enc(w);
+	enc.value(v);
+}
+
+class BinaryDecoder {
+public:
+	BinaryDecoder(std::string_view data, String *err, KeyTable *keys):
+		start_((const unsigned char *)data.data()),
+		cur_(start_), end_(start_ + data.size()),
+		err_(err), keyTable_(keys) {}
+
+	bool magic() {
+		if (size_t(end_ - cur_) < sizeof(binaryMagic) ||
+				memcmp(cur_, binaryMagic, sizeof(binaryMagic)) != 0) {
+			return error("Not a binary MASON document");
+		}
+
+		cur_ += sizeof(binaryMagic);
+		return true;
+	}
+
+	bool value(Value &v, int depth) {
+		if (depth <= 0) {
+			return error("Nesting limit exceeded");
+		}
+
+		if (cur_ == end_) {
+			return error("Unexpected end of input");
+		}
+
+		unsigned char tag = *cur_;
+		cur_ += 1;
+		uint64_t num;
+		switch (tag) {
+		case TagNull:
+			v.set(Null{});
+			return true;
+
+		case TagFalse:
+		case TagTrue:
+			v.set(Bool(tag == TagTrue));
+			return true;
+
+		case TagNumber: {
+			if (end_ - cur_ < 8) {
+				return error("Unexpected end of input");
+			}
+
+			uint64_t bits = 0;
+			for (int i = 0; i < 8; ++i) {
+				bits |= uint64_t(cur_[i]) << (i * 8);
+			}
+			cur_ += 8;
+
+			Number n;
+			memcpy(&n, &bits, sizeof(n));
+			v.set(Number(n));
+			return true;
+		}
+
+		case TagInt:
+			if (!varint(num)) {
+				return false;
+			}
+			v.set(Int((num >> 1) ^ -(num & 1)));
+			return true;
+
+		case TagUInt:
+			if (!varint(num)) {
+				return false;
+			}
+			v.set(UInt(num));
+			return true;
+
+		case TagString: {
+			std::string_view str;
+			if (!bytes(str)) {
+				return false;
+			}
+			v.set(String(str));
+			return true;
+		}
+
+		case TagBString: {
+			std::string_view str;
+			if (!bytes(str)) {
+				return false;
+			}
+			auto *p = (const unsigned char *)str.data();
+			v.set(BString(p, p + str.size()));
+			return true;
+		}
+
+		case TagArray:
+		case TagObject:
+			if (!varint(num)) {
+				return false;
+			}
+			if (tag == TagArray) {
+				return array(v.set(Array{}), num, depth - 1);
+			} else {
+				return object(v.set(Object{}), num, depth - 1);
+			}
+
+		default:
+			cur_ -= 1;
+			return error("Invalid tag");
+		}
+	}
+
+	bool finish() {
+		if (cur_ != end_) {
+			return error("Trailing data after value");
+		}
+
+		return true;
+	}
+
+private:
+	bool array(Array &arr, uint64_t size, int depth) {
+		// Every element takes at least one byte, so the size can't
+		// be trusted to be sensible until it's checked against that
+		arr.reserve(std::min<uint64_t>(size, end_ - cur_));
+		for (uint64_t i = 0; i < size; ++i) {
+			auto &val = arr.emplace_back(std::make_shared<Value>());
+			if (!value(*val, depth)) {
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool object(Object &obj, uint64_t size, int depth) {
+		obj.reserve(std::min<uint64_t>(size, (end_ - cur_) / 2));
+		for (uint64_t i = 0; i < size; ++i) {
+			Key k;
+			if (!key(k)) {
+				return false;
+			}
+
+			auto val = std::make_shared<Value>();
+			if (!value(*val, depth)) {
+				return false;
+			}
+			obj.emplace(std::move(k), std::move(val));
+		}
+
+		return true;
+	}
+
+	bool key(Key &k) {
+		uint64_t num;
+		if (!varint(num)) {
+			return false;
+		}
+
+		if (num & 1) {
+			if ((num >> 1) >= keys_.size()) {
+				return error("Invalid key reference");
+			}
+
+			k = keys_[num >> 1];
+			return true;
+		}
+
+		if ((num >> 1) > uint64_t(end_ - cur_)) {
+			return error("Unexpected end of input");
+		}
+
+		std::string_view str((const char *)cur_, num >> 1);
+		cur_ += str.size();
+		const KeyData *data = keyTable_ ? keyTable_->intern(str) : nullptr;
+		if (data) {
+			k = Key(data);
+		} else {
+			k = Key(str);
+		}
+		keys_.push_back(k);
+		return true;
+	}
+
+	// A varint length followed by that many bytes
+	bool bytes(std::string_view &str) {
+		uint64_t size;
+		if (!varint(size)) {
+			return false;
+		}
+
+		if (size > uint64_t(end_ - cur_)) {
+			return error("Unexpected end of input");
+		}
+
+		str = std::string_view((const char *)cur_, size);
+		cur_ += size;
+		return true;
+	}
+
+	bool varint(uint64_t &num) {
+		num = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (cur_ == end_) {
+				return error("Unexpected end of input");
+			}
+
+			unsigned char byte = *(cur_++);
+			num |= uint64_t(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+
+		return error("Invalid varint");
+	}
+
+	bool error(const char *what) {
+		if (err_) {
+			*err_ = "Offset ";
+			*err_ += std::to_string(cur_ - start_);
+			*err_ += ": ";
+			*err_ += what;
+		}
+
+		return false;
+	}
+
+	const unsigned char *start_;
+	const unsigned char *cur_;
+	const unsigned char *end_;
+	String *err_;
+	KeyTable *keyTable_;
+
+	// Every new key so far, in order, for key references
+	std::vector<Key> keys_;
+};
+
+bool decodeBinary(
+	std::string_view data, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
+{
+	BinaryDecoder dec(data, err, keys);
+	if (!dec.magic() || !dec.value(v, maxDepth) || !dec.finish()) {
+		v.set(Null{});
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,300 @@
+#include "codec.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Mason {
+
+static const char base64Alphabet[] =
+	"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+	"abcdefghijklmnopqrstuvwxyz"
+	"0123456789+/";
+
+static const char hexAlphabet[] = "0123456789abcdef";
+
+// The two base64 characters for each 12-bit value,
+// so that three bytes can be encoded with two lookups
+static const auto base64Pairs = [] {
+	std::array<std::array<char, 2>, 4096> table{};
+	for (size_t i = 0; i < table.size(); ++i) {
+		table[i] = {base64Alphabet[i >> 6], base64Alphabet[i & 0x3f]};
+	}
+	return table;
+}();
+
+// The value of each hex digit, or 0xff
+static const auto hexValues = [] {
+	std::array<unsigned char, 256> table;
+	table.fill(0xff);
+	for (int i = 0; i < 10; ++i) {
+		table['0' + i] = i;
+	}
+	for (int i = 0; i < 6; ++i) {
+		table['a' + i] = 10 + i;
+		table['A' + i] = 10 + i;
+	}
+	return table;
+}();
+
+#if defined(__AVX2__)
+// Encode 24 bytes as 32 base64 characters.
+// This is Wojciech Muła and Daniel Lemire's method: each group of
+// three bytes is spread out over a 32-bit word, the four 6-bit values
+// are moved into their own bytes with multiplications,
+// and then turned into characters by adding an offset which depends
+// on which range of the alphabet they're in.
+// It reads 28 bytes.
+static inline __m256i encodeBase64Block(const unsigned char *p)
+{
+	__m256i in = _mm256_inserti128_si256(
+		_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+		_mm_loadu_si128((const __m128i *)(p + 12)), 1);
+	in = _mm256_shuffle_epi8(in, _mm256_setr_epi8(
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+		1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+	__m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+	__m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+	__m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+	__m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+	__m256i values = _mm256_or_si256(t1, t3);
+
+	// 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+	__m256i range = _mm256_subs_epu8(values, _mm256_set1_epi8(51));
+	__m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), values);
+	range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+
+	__m256i offsets = _mm256_setr_epi8(
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+		'/' - 63, 'A', 0, 0,
+		'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+		'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+		'/' - 63, 'A', 0, 0);
+	return _mm256_add_epi8(values, _mm256_shuffle_epi8(offsets, range));
+}
+#endif
+
+size_t encodeBase64(const unsigned char *data, size_t size, char *out)
+{
+	char *start = out;
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 28 <= size; i += 24) {
+		_mm256_storeu_si256((__m256i *)out, encodeBase64Block(data + i));
+		out += 32;
+	}
+#endif
+
+	for (; i + 3 <= size; i += 3) {
+		uint32_t v = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+		memcpy(out, base64Pairs[v >> 12].data(), 2);
+		memcpy(out + 2, base64Pairs[v & 0xfff].data(), 2);
+		out += 4;
+	}
+
+	if (i < size) {
+		uint32_t v = data[i] << 16;
+		if (i + 1 < size) {
+			v |= data[i + 1] << 8;
+		}
+
+		out[0] = base64Alphabet[v >> 18];
+		out[1] = base64Alphabet[(v >> 12) & 0x3f];
+		out[2] = i + 1 < size ? base64Alphabet[(v >> 6) & 0x3f] : '=';
+		out[3] = '=';
+		out += 4;
+	}
+
+	return out - start;
+}
+
+#if defined(__SSE2__)
+// Turn bytes with values 0..15 into hex digits
+static inline __m128i hexDigits(__m128i nibbles)
+{
+	__m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+	return _mm_add_epi8(
+		_mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+		_mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+// Get the high and low hex digits of 16 bytes
+static inline void hexDigits(const unsigned char *p, __m128i &hi, __m128i &lo)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)p);
+	hi = hexDigits(_mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f)));
+	lo = hexDigits(_mm_and_si128(v, _mm_set1_epi8(0x0f)));
+}
+#endif
+
+size_t encodeHex(const unsigned char *data, size_t size, char *out)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 16 <= size; i += 16) {
+		__m128i hi, lo;
+		hexDigits(data + i, hi, lo);
+		_mm_storeu_si128((__m128i *)(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+#endif
+
+	for (; i < size; ++i) {
+		out[i * 2] = hexAlphabet[data[i] >> 4];
+		out[i * 2 + 1] = hexAlphabet[data[i] & 0x0f];
+	}
+
+	return size * 2;
+}
+
+#if defined(__SSE2__)
+// Get the values of 16 hex digits.
+// Returns a mask with a bit set for each character which isn't one.
+static inline int hexValues16(__m128i chars, __m128i &values)
+{
+	// Unsigned x <= max is min(x, max) == x
+	__m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+	__m128i isDigit = _mm_cmpeq_epi8(
+		_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+	__m128i letter = _mm_sub_epi8(
+		_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i isLetter = _mm_cmpeq_epi8(
+		_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+
+	values = _mm_or_si128(
+		_mm_and_si128(isDigit, digit),
+		_mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+	return ~_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) & 0xffff;
+}
+#endif
+
+bool decodeHex(std::string_view str, BString &out)
+{
+	if (str.size() % 2 != 0) {
+		return false;
+	}
+
+	size_t start = out.size();
+	out.resize(start + str.size() / 2);
+	unsigned char *dest = out.data() + start;
+
+	auto *p = (const unsigned char *)str.data();
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// Each 16-bit lane holds a high and a low digit
+	for (; i + 16 <= str.size(); i += 16) {
+		__m128i values;
+		if (hexValues16(_mm_loadu_si128((const __m128i *)(p + i)), values)) {
+			return false;
+		}
+
+		__m128i bytes = _mm_or_si128(
+			_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0xff)), 4),
+			_mm_srli_epi16(values, 8));
+		_mm_storel_epi64(
+			(__m128i *)(dest + i / 2), _mm_packus_epi16(bytes, bytes));
+	}
+#endif
+
+	for (; i < str.size(); i += 2) {
+		unsigned char hi = hexValues[p[i]];
+		unsigned char lo = hexValues[p[i + 1]];
+		if ((hi | lo) == 0xff) {
+			return false;
+		}
+
+		dest[i / 2] = hi << 4 | lo;
+	}
+
+	return true;
+}
+
+size_t decodeHexEscapes(std::string_view str, BString &out)
+{
+	auto *p = (const unsigned char *)str.data();
+	size_t n = str.size();
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// Four escapes at a time, one in each 32-bit lane
+	__m128i prefix = _mm_set1_epi32('\\' | 'x' << 8);
+	for (; i + 16 <= n; i += 16) {
+		__m128i chars = _mm_loadu_si128((const __m128i *)(p + i));
+		int prefixes = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, prefix));
+
+		__m128i values;
+		int invalid = hexValues16(chars, values);
+		if ((prefixes & 0x3333) != 0x3333 || (invalid & 0xcccc) != 0) {
+			break;
+		}
+
+		values = _mm_srli_epi32(values, 16);
+		__m128i bytes = _mm_or_si128(
+			_mm_slli_epi32(_mm_and_si128(values, _mm_set1_epi32(0xff)), 4),
+			_mm_srli_epi32(values, 8));
+		bytes = _mm_packs_epi32(bytes, bytes);
+		bytes = _mm_packus_epi16(bytes, bytes);
+
+		uint32_t word = _mm_cvtsi128_si32(bytes);
+		size_t size = out.size();
+		out.resize(size + 4);
+		memcpy(out.data() + size, &word, 4);
+	}
+#endif
+
+	for (; i + 4 <= n && p[i] == '\\' && p[i + 1] == 'x'; i += 4) {
+		unsigned char hi = hexValues[p[i + 2]];
+		unsigned char lo = hexValues[p[i + 3]];
+		if ((hi | lo) == 0xff) {
+			break;
+		}
+
+		out.push_back(hi << 4 | lo);
+	}
+
+	return i;
+}
+
+size_t encodeHexEscapes(const unsigned char *data, size_t size, char *out)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// Interleave each pair of hex digits with a "\x"
+	__m128i prefix = _mm_set1_epi16('\\' | 'x' << 8);
+	for (; i + 16 <= size; i += 16) {
+		__m128i hi, lo;
+		hexDigits(data + i, hi, lo);
+		__m128i first = _mm_unpacklo_epi8(hi, lo);
+		__m128i second = _mm_unpackhi_epi8(hi, lo);
+
+		char *dest = out + i * 4;
+		_mm_storeu_si128((__m128i *)dest, _mm_unpacklo_epi16(prefix, first));
+		_mm_storeu_si128((__m128i *)(dest + 16), _mm_unpackhi_epi16(prefix, first));
+		_mm_storeu_si128((__m128i *)(dest + 32), _mm_unpacklo_epi16(prefix, second));
+		_mm_storeu_si128((__m128i *)(dest + 48), _mm_unpackhi_epi16(prefix, second));
+	}
+#endif
+
+	for (; i < size; ++i) {
+		char *dest = out + i * 4;
+		dest[0] = '\\';
+		dest[1] = 'x';
+		dest[2] = hexAlphabet[data[i] >> 4];
+		dest[3] = hexAlphabet[data[i] & 0x0f];
+	}
+
+	return size * 4;
+}
+
+}
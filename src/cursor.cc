@@ -0,0 +1,495 @@
+#include "cursor.h"
+#include "parser.h"
+
+namespace Mason {
+
+// Receives the value of a single number
+struct NumberBuilder {
+	Type type = Type::Number;
+	Number num = 0;
+	Int i = 0;
+	UInt u = 0;
+
+	bool number(Number n) { type = Type::Number; num = n; return true; }
+	bool number(Int n) { type = Type::Int; i = n; return true; }
+	bool number(UInt n) { type = Type::UInt; u = n; return true; }
+};
+
+Cursor::Cursor(std::istream &is, int maxDepth):
+	reader_(new Reader(is)), maxDepth_(maxDepth) {}
+
+Cursor::Cursor(std::string_view str, int maxDepth):
+	reader_(new Reader(str.data(), str.size())), maxDepth_(maxDepth) {}
+
+Cursor::~Cursor() = default;
+
+Cursor::Token Cursor::next()
+{
+	if (token_ == Token::Error || token_ == Token::End) {
+		return token_;
+	}
+
+	if (!finishToken()) {
+		return fail();
+	}
+
+	done_ = false;
+	token_ = findToken();
+	return token_;
+}
+
+bool Cursor::readKey(std::string_view &key)
+{
+	if (token_ != Token::Key || done_) {
+		return false;
+	}
+
+	if (!consumed_) {
+		if (!parseKey(*reader_, buffer_, &err_)) {
+			fail();
+			return false;
+		}
+		consumed_ = true;
+	}
+
+	key = buffer_;
+	return true;
+}
+
+bool Cursor::readString(std::string_view &str)
+{
+	if (token_ != Token::String || done_) {
+		return false;
+	}
+
+	if (!consumed_) {
+		Reader &r = *reader_;
+		bool ok;
+		int ch = r.peek();
+		if (ch == '"') {
+			ok = parseString(r, buffer_, &err_);
+		} else if (ch == '|') {
+			ok = parseMultiLineString(r, buffer_, &err_);
+		} else {
+			ok = parseRawString(r, buffer_, &err_);
+		}
+
+		if (!ok) {
+			fail();
+			return false;
+		}
+		consumed_ = true;
+	}
+
+	str = buffer_;
+	return true;
+}
+
+bool Cursor::readBString(BString &bytes)
+{
+	if (token_ != Token::BString || done_) {
+		return false;
+	}
+
+	if (!consumed_) {
+		if (!parseBinaryString(*reader_, bytes_, &err_)) {
+			fail();
+			return false;
+		}
+		consumed_ = true;
+	}
+
+	bytes = bytes_;
+	return true;
+}
+
+bool Cursor::readBool(Bool &b)
+{
+	if (token_ != Token::Bool || done_) {
+		return false;
+	}
+
+	b = bool_;
+	return true;
+}
+
+bool Cursor::readNumberToken()
+{
+	if (token_ != Token::Number || done_) {
+		return false;
+	}
+
+	if (!consumed_) {
+		NumberBuilder b;
+		if (!parseNumber(*reader_, b, &err_)) {
+			fail();
+			return false;
+		}
+
+		numType_ = b.type;
+		number_ = b.num;
+		int_ = b.i;
+		uint_ = b.u;
+		consumed_ = true;
+	}
+
+	return true;
+}
+
+bool Cursor::readNumber(Number &num)
+{
+	if (!readNumberToken()) {
+		return false;
+	}
+
+	if (numType_ == Type::Int) {
+		num = Number(int_);
+	} else if (numType_ == Type::UInt) {
+		num = Number(uint_);
+	} else {
+		num = number_;
+	}
+	return true;
+}
+
+bool Cursor::readInt(Int &num)
+{
+	if (!readNumberToken() || numType_ != Type::Int) {
+		return false;
+	}
+
+	num = int_;
+	return true;
+}
+
+bool Cursor::readUInt(UInt &num)
+{
+	if (!readNumberToken()) {
+		return false;
+	}
+
+	if (numType_ == Type::UInt) {
+		num = uint_;
+		return true;
+	} else if (numType_ == Type::Int && int_ >= 0) {
+		num = UInt(int_);
+		return true;
+	}
+
+	return false;
+}
+
+bool Cursor::skipValue()
+{
+	if (token_ == Token::Error) {
+		return false;
+	} else if (done_) {
+		return true;
+	}
+
+	Reader &r = *reader_;
+	bool ok = true;
+	if (token_ == Token::Key) {
+		ok = finishKey();
+		if (ok) {
+			frames_.back().hasSep = r.peek() == '|';
+			ok = Mason::skipValue(r, &err_) && valueDone();
+		}
+	} else if (
+		(token_ == Token::BeginArray || token_ == Token::BeginObject) &&
+		!consumed_) {
+		r.get();
+		ok = skipNested(r, &err_) && valueDone();
+	} else if (token_ == Token::BeginObject) {
+		// A top-level object without braces goes on until the end
+		// of the document, so there's no closing bracket to look for
+		while (ok && !frames_.empty()) {
+			Token tok = next();
+			if (tok == Token::Error) {
+				return false;
+			} else if (tok == Token::Key) {
+				ok = skipValue();
+			}
+		}
+
+		ok = ok && finishToken();
+	} else {
+		ok = finishToken();
+	}
+
+	if (!ok) {
+		fail();
+		return false;
+	}
+
+	done_ = true;
+	return true;
+}
+
+// Read past the current token, if it hasn't already been read
+bool Cursor::finishToken()
+{
+	if (done_) {
+		return true;
+	}
+
+	Reader &r = *reader_;
+	switch (token_) {
+	case Token::None:
+		return skipWhitespace(r, &err_);
+
+	case Token::Null:
+	case Token::Bool:
+	case Token::Number:
+	case Token::String:
+	case Token::BString:
+		if (!consumed_ && !Mason::skipValue(r, &err_)) {
+			return false;
+		}
+		return valueDone();
+
+	case Token::BeginArray:
+	case Token::BeginObject:
+		if (consumed_) {
+			return true;
+		}
+
+		r.get();
+		frames_.push_back({
+			token_ == Token::BeginArray ? '[' : '{', Frame::First, false});
+		return skipWhitespace(r, &err_);
+
+	case Token::Key:
+		return finishKey();
+
+	case Token::EndArray:
+	case Token::EndObject:
+		return valueDone();
+
+	default:
+		return true;
+	}
+}
+
+// Read past a key and its ':'
+bool Cursor::finishKey()
+{
+	Reader &r = *reader_;
+	if (!consumed_) {
+		bool ok;
+		if (r.peek() == '"') {
+			ok = skipQuotedString(r, &err_);
+		} else {
+			ok = parseIdentifier(r, buffer_, &err_);
+		}
+
+		if (!ok) {
+			return false;
+		}
+	}
+
+	if (!skipWhitespace(r, &err_)) {
+		return false;
+	}
+
+	if (r.peek() != ':') {
+		Mason::error(r.loc(), &err_, "Expected ':'");
+		return false;
+	}
+	r.get();
+
+	frames_.back().state = Frame::Value;
+	return skipWhitespace(r, &err_);
+}
+
+// Skip the separator after a value which has been read
+bool Cursor::valueDone()
+{
+	Reader &r = *reader_;
+	if (frames_.empty()) {
+		rootDone_ = true;
+		return skipWhitespace(r, &err_);
+	}
+
+	Frame &f = frames_.back();
+	bool hasSep;
+	if (!skipSep(r, hasSep, &err_)) {
+		return false;
+	}
+	f.hasSep = f.hasSep || hasSep;
+	f.state = Frame::AfterValue;
+
+	if (f.kind != '[') {
+		return skipWhitespace(r, &err_);
+	}
+	return true;
+}
+
+// Find the next token, once the previous one has been read
+Cursor::Token Cursor::findToken()
+{
+	Reader &r = *reader_;
+	consumed_ = true;
+
+	if (frames_.empty()) {
+		if (!rootDone_) {
+			return findValue(true);
+		}
+
+		if (r.peek() != EOF) {
+			Mason::error(r.loc(), &err_, "Trailing garbage after document");
+			return fail();
+		}
+		return Token::End;
+	}
+
+	Frame &f = frames_.back();
+	int ch = r.peek();
+
+	if (f.kind == '[') {
+		if (ch == ']') {
+			r.get();
+			frames_.pop_back();
+			return Token::EndArray;
+		}
+
+		if (f.state == Frame::AfterValue) {
+			if (ch == EOF) {
+				Mason::error(r.loc(), &err_, "Unexpected EOF");
+				return fail();
+			}
+
+			if (!f.hasSep) {
+				Mason::error(r.loc(), &err_, "Expected separator or ']'");
+				return fail();
+			}
+
+			if (!skipWhitespace(r, &err_)) {
+				return fail();
+			}
+		}
+
+		// If the next value is a multi-line string,
+		// always assume that we have had a separator
+		f.hasSep = r.peek() == '|';
+		return findValue(false);
+	}
+
+	if (f.state == Frame::Value) {
+		f.hasSep = ch == '|';
+		return findValue(false);
+	}
+
+	// The first key of a top-level object has already been read
+	if (f.kind == 't' && f.state == Frame::First) {
+		return Token::Key;
+	}
+
+	if (f.kind == '{' && ch == '}') {
+		r.get();
+		frames_.pop_back();
+		return Token::EndObject;
+	}
+
+	if (f.state == Frame::AfterValue) {
+		if (f.kind == 't' && ch == EOF) {
+			frames_.pop_back();
+			return Token::EndObject;
+		} else if (f.kind == 't' && ch == '}') {
+			Mason::error(r.loc(), &err_, "Trailing garbage after document");
+			return fail();
+		} else if (ch == EOF) {
+			Mason::error(r.loc(), &err_, "Expected '{'");
+			return fail();
+		}
+
+		if (!f.hasSep) {
+			Mason::error(r.loc(), &err_, "Expected separator, '}' or EOF");
+			return fail();
+		}
+	}
+
+	consumed_ = false;
+	return Token::Key;
+}
+
+Cursor::Token Cursor::findValue(bool topLevel)
+{
+	Reader &r = *reader_;
+	if (int(frames_.size()) >= maxDepth_) {
+		Mason::error(r.loc(), &err_, "Nesting limit exceeded");
+		return fail();
+	}
+
+	int ch = r.peek();
+	if (ch == EOF) {
+		Mason::error(r.loc(), &err_, "Unexpected EOF");
+		return fail();
+	}
+
+	consumed_ = false;
+	if (ch == '[') {
+		return Token::BeginArray;
+	} else if (ch == '{') {
+		return Token::BeginObject;
+	} else if (ch == '"' && !topLevel) {
+		return Token::String;
+	} else if (ch == 'r' && (r.peek2() == '"' || r.peek2() == '#')) {
+		return Token::String;
+	} else if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '+' || ch == '-') {
+		return Token::Number;
+	} else if (ch == 'b' && r.peek2() == '"') {
+		return Token::BString;
+	} else if (ch == '|') {
+		return Token::String;
+	}
+
+	// Keywords are read right away, and so are top-level strings,
+	// since they might turn out to be keys
+	consumed_ = true;
+	auto loc = r.loc();
+	bool ok;
+	if (ch == '"') {
+		ok = parseString(r, buffer_, &err_);
+	} else {
+		ok = parseIdentifier(r, buffer_, &err_);
+	}
+
+	if (!ok) {
+		return fail();
+	}
+
+	if (topLevel) {
+		if (!skipWhitespace(r, &err_)) {
+			return fail();
+		}
+
+		if (r.peek() == ':') {
+			frames_.push_back({'t', Frame::First, false});
+			return Token::BeginObject;
+		}
+	}
+
+	if (ch == '"') {
+		return Token::String;
+	} else if (buffer_ == "null") {
+		return Token::Null;
+	} else if (buffer_ == "true") {
+		bool_ = true;
+		return Token::Bool;
+	} else if (buffer_ == "false") {
+		bool_ = false;
+		return Token::Bool;
+	}
+
+	Mason::error(loc, &err_, "Unexpected keyword");
+	return fail();
+}
+
+Cursor::Token Cursor::fail()
+{
+	token_ = Token::Error;
+	return token_;
+}
+
+}
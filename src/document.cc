@@ -0,0 +1,247 @@
+#include "document.h"
+#include "parser.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace Mason {
+
+Arena::Arena(Arena &&other)
+{
+	*this = std::move(other);
+}
+
+Arena &Arena::operator=(Arena &&other)
+{
+	if (this == &other) {
+		return *this;
+	}
+
+	clear();
+	free(blocks_);
+
+	cur_ = other.cur_;
+	end_ = other.end_;
+	blocks_ = other.blocks_;
+	nextSize_ = other.nextSize_;
+
+	other.cur_ = nullptr;
+	other.end_ = nullptr;
+	other.blocks_ = nullptr;
+	return *this;
+}
+
+Arena::~Arena()
+{
+	clear();
+	free(blocks_);
+}
+
+void Arena::clear()
+{
+	if (!blocks_) {
+		return;
+	}
+
+	Block *block = blocks_->next;
+	while (block) {
+		Block *next = block->next;
+		free(block);
+		block = next;
+	}
+
+	blocks_->next = nullptr;
+	cur_ = (char *)(blocks_ + 1);
+	end_ = (char *)blocks_ + blocks_->size;
+}
+
+void *Arena::allocBlock(size_t size, size_t align)
+{
+	size_t blockSize = nextSize_;
+	size_t needed = sizeof(Block) + size + align;
+	if (needed > blockSize) {
+		blockSize = needed;
+	}
+
+	// Grow geometrically, so that big documents need few blocks
+	if (nextSize_ < 1024 * 1024) {
+		nextSize_ *= 2;
+	}
+
+	auto *block = (Block *)malloc(blockSize);
+	if (!block) {
+		throw std::bad_alloc();
+	}
+
+	block->next = blocks_;
+	block->size = blockSize;
+	blocks_ = block;
+	cur_ = (char *)(block + 1);
+	end_ = (char *)block + blockSize;
+	return alloc(size, align);
+}
+
+const Node *Node::find(std::string_view key) const
+{
+	const Member *mems = members();
+	for (size_t i = size(); i > 0; --i) {
+		if (mems[i - 1].key == key) {
+			return &mems[i - 1].value;
+		}
+	}
+
+	return nullptr;
+}
+
+// Builds a Document.
+// Finished values are kept on a stack until their parent container is done,
+// at which point they are copied into one exactly sized arena allocation.
+// Object members are kept on the stack as a key node followed by a value node.
+class DocumentBuilder {
+public:
+	DocumentBuilder(Document &doc): doc_(doc) {}
+
+	String &buffer() { return buffer_; }
+
+	bool null() {
+		stack_.emplace_back();
+		return true;
+	}
+
+	bool boolean(Bool b) {
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::Bool;
+		node.b_ = b;
+		return true;
+	}
+
+	bool number(Number num) {
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::Number;
+		node.num_ = num;
+		return true;
+	}
+
+	bool number(Int num) {
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::Int;
+		node.int_ = num;
+		return true;
+	}
+
+	bool number(UInt num) {
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::UInt;
+		node.uint_ = num;
+		return true;
+	}
+
+	bool string() {
+		pushData(Node::Type::String, buffer_.data(), buffer_.size());
+		return true;
+	}
+
+	bool bstring(BString &bytes) {
+		pushData(Node::Type::BString, bytes.data(), bytes.size());
+		return true;
+	}
+
+	bool beginArray() {
+		frames_.push_back(stack_.size());
+		return true;
+	}
+
+	bool endArray() {
+		size_t start = frames_.back();
+		frames_.pop_back();
+
+		size_t count = stack_.size() - start;
+		Node *items = doc_.arena_.alloc<Node>(count);
+		std::copy(stack_.begin() + start, stack_.end(), items);
+		stack_.resize(start);
+
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::Array;
+		node.data_ = {items, count};
+		return true;
+	}
+
+	bool beginObject() {
+		frames_.push_back(stack_.size());
+		return true;
+	}
+
+	bool key() { return string(); }
+
+	bool endObject() {
+		size_t start = frames_.back();
+		frames_.pop_back();
+
+		size_t count = (stack_.size() - start) / 2;
+		Member *members = doc_.arena_.alloc<Member>(count);
+		for (size_t i = 0; i < count; ++i) {
+			members[i].key = stack_[start + i * 2].string();
+			members[i].value = stack_[start + i * 2 + 1];
+		}
+		stack_.resize(start);
+
+		Node &node = stack_.emplace_back();
+		node.type_ = Node::Type::Object;
+		node.data_ = {members, count};
+		return true;
+	}
+
+	void finish() {
+		doc_.root_ = stack_.back();
+	}
+
+private:
+	void pushData(Node::Type type, const void *data, size_t size) {
+		void *copy = doc_.arena_.alloc(size, 1);
+		if (size > 0) {
+			memcpy(copy, data, size);
+		}
+
+		Node &node = stack_.emplace_back();
+		node.type_ = type;
+		node.data_ = {copy, size};
+	}
+
+	Document &doc_;
+	std::vector<Node> stack_;
+	std::vector<size_t> frames_;
+	String buffer_;
+};
+
+static bool parseDocumentDocument(
+	Reader &r, Document &doc, String *err, int maxDepth)
+{
+	doc.clear();
+
+	DocumentBuilder b(doc);
+	if (!parseDocument(r, b, err, maxDepth)) {
+		doc.clear();
+		return false;
+	}
+
+	b.finish();
+	return true;
+}
+
+bool parse(
+	std::istream &is, Document &doc,
+	String *err, int maxDepth)
+{
+	Reader r(is);
+	return parseDocumentDocument(r, doc, err, maxDepth);
+}
+
+bool parse(
+	std::string_view str, Document &doc,
+	String *err, int maxDepth)
+{
+	Reader r(str.data(), str.size());
+	return parseDocumentDocument(r, doc, err, maxDepth);
+}
+
+}
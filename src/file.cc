@@ -0,0 +1,162 @@
+#include "mason.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Mason {
+
+static void fileError(const char *what, String *err)
+{
+	if (!err) {
+		return;
+	}
+
+	*err = what;
+	*err += ": ";
+	*err += strerror(errno);
+}
+
+FileData::FileData(FileData &&other)
+{
+	*this = std::move(other);
+}
+
+FileData &FileData::operator=(FileData &&other)
+{
+	if (this == &other) {
+		return *this;
+	}
+
+	close();
+	mapped_ = other.mapped_;
+	buffer_ = std::move(other.buffer_);
+	if (mapped_) {
+		data_ = other.data_;
+	} else {
+		data_ = buffer_.data();
+	}
+	size_ = other.size_;
+
+	other.data_ = "";
+	other.size_ = 0;
+	other.mapped_ = false;
+	return *this;
+}
+
+FileData::~FileData()
+{
+	close();
+}
+
+void FileData::close()
+{
+	if (mapped_) {
+		munmap((void *)data_, size_);
+	}
+
+	buffer_.clear();
+	data_ = "";
+	size_ = 0;
+	mapped_ = false;
+}
+
+bool FileData::open(const char *path, String *err)
+{
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		fileError(path, err);
+		return false;
+	}
+
+	bool ok = open(fd, err);
+	::close(fd);
+	if (!ok && err) {
+		*err = path + (": " + *err);
+	}
+
+	return ok;
+}
+
+bool FileData::open(int fd, String *err)
+{
+	close();
+
+	// Only regular files read from the start can be mapped;
+	// pipes, terminals and sockets are read into memory instead.
+	// Files in /proc and /sys claim to be empty but aren't,
+	// so empty files are read too.
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		fileError("fstat", err);
+		return false;
+	}
+
+	bool sized = S_ISREG(st.st_mode) && st.st_size > 0;
+	if (sized && lseek(fd, 0, SEEK_CUR) == 0) {
+		void *ptr = mmap(
+			nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (ptr != MAP_FAILED) {
+			madvise(ptr, st.st_size, MADV_SEQUENTIAL);
+			data_ = (const char *)ptr;
+			size_ = st.st_size;
+			mapped_ = true;
+			return true;
+		}
+	}
+
+	size_t size = 0;
+	buffer_.resize(sized ? st.st_size + 1 : 64 * 1024);
+	while (true) {
+		if (size == buffer_.size()) {
+			buffer_.resize(buffer_.size() * 2);
+		}
+
+		ssize_t n = ::read(fd, &buffer_[size], buffer_.size() - size);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n < 0) {
+			fileError("read", err);
+			buffer_.clear();
+			return false;
+		} else if (n == 0) {
+			break;
+		}
+
+		size += n;
+	}
+
+	buffer_.resize(size);
+	data_ = buffer_.data();
+	size_ = size;
+	return true;
+}
+
+bool parseFile(
+	const char *path, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
+{
+	FileData file;
+	if (!file.open(path, err)) {
+		return false;
+	}
+
+	return parse(file.view(), v, err, maxDepth, keys);
+}
+
+bool parseFile(
+	int fd, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
+{
+	FileData file;
+	if (!file.open(fd, err)) {
+		return false;
+	}
+
+	return parse(file.view(), v, err, maxDepth, keys);
+}
+
+}
@@ -0,0 +1,52 @@
+#include "parser.h"
+
+namespace Mason {
+
+// Passes parser events on to a user-provided Handler
+class HandlerBuilder {
+public:
+	HandlerBuilder(Handler &h): h_(h) {}
+
+	String &buffer() { return buffer_; }
+
+	bool null() { return h_.onNull(); }
+	bool boolean(Bool b) { return h_.onBool(b); }
+	bool number(Number num) { return h_.onNumber(num); }
+	bool number(Int num) { return h_.onInt(num); }
+	bool number(UInt num) { return h_.onUInt(num); }
+	bool string() { return h_.onString(buffer_); }
+
+	bool bstring(BString &bytes) {
+		return h_.onBString(bytes.data(), bytes.size());
+	}
+
+	bool beginArray() { return h_.onBeginArray(); }
+	bool endArray() { return h_.onEndArray(); }
+	bool beginObject() { return h_.onBeginObject(); }
+	bool key() { return h_.onKey(buffer_); }
+	bool endObject() { return h_.onEndObject(); }
+
+private:
+	Handler &h_;
+	String buffer_;
+};
+
+bool parse(
+	std::istream &is, Handler &h,
+	String *err, int maxDepth)
+{
+	Reader r(is);
+	HandlerBuilder b(h);
+	return parseDocument(r, b, err, maxDepth);
+}
+
+bool parse(
+	std::string_view str, Handler &h,
+	String *err, int maxDepth)
+{
+	Reader r(str.data(), str.size());
+	HandlerBuilder b(h);
+	return parseDocument(r, b, err, maxDepth);
+}
+
+}
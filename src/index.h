@@ -0,0 +1,277 @@
+#pragma once
+
+// A structural index of a document which is in memory.
+// One pass over the input finds the brackets, separators, strings and
+// comments, and counts the elements of every array and object,
+// so that a builder can reserve exactly the right amount of space
+// before the parser fills a container in. It's used by parseIndexed.
+//
+// The pass only follows the structure and doesn't validate anything.
+// For an invalid document, the counts may be off, and the parser
+// reports the error as usual.
+
+#include "scan.h"
+
+#include <array>
+#include <cstring>
+#include <vector>
+
+namespace Mason {
+
+class StructuralIndex {
+public:
+	inline void build(const unsigned char *data, size_t size);
+
+	// The number of elements in the next array or object,
+	// in the order the parser starts them in.
+	// An object without braces at the top level starts at its first ':'.
+	size_t nextSize() {
+		return next_ < sizes_.size() ? sizes_[next_++] : 0;
+	}
+
+private:
+	static constexpr size_t none = ~size_t(0);
+
+	// The current state of an array or object,
+	// or of the top level of the document
+	struct Frame {
+		size_t entry; // Index into sizes_
+		bool inElement; // After the start of an element and before a separator
+		bool afterColon; // Between a key's ':' and its value
+	};
+
+	void startContent() {
+		Frame &f = stack_.back();
+		if (f.afterColon) {
+			f.afterColon = false;
+		} else if (!f.inElement) {
+			f.inElement = true;
+			if (f.entry != none) {
+				sizes_[f.entry] += 1;
+			}
+		}
+	}
+
+	// A separator only ends an element if the element has a value
+	void separator() {
+		Frame &f = stack_.back();
+		if (!f.afterColon) {
+			f.inElement = false;
+		}
+	}
+
+	inline size_t skipString(const unsigned char *data, size_t size, size_t i);
+	inline size_t skipRawString(const unsigned char *data, size_t size, size_t i);
+	inline size_t skipBlockComment(const unsigned char *data, size_t size, size_t i);
+	inline size_t skipLine(const unsigned char *data, size_t size, size_t i);
+
+	std::vector<uint32_t> sizes_;
+	std::vector<Frame> stack_;
+	size_t next_ = 0;
+};
+
+// Each of the skip functions takes the index of the first character
+// of the thing to skip, and returns the index just past it
+
+size_t StructuralIndex::skipString(
+	const unsigned char *data, size_t size, size_t i)
+{
+	i += 1; // '"'
+	while (i < size) {
+		i += findStringSpecial(data + i, size - i);
+		if (i >= size) {
+			break;
+		}
+
+		if (data[i] == '"') {
+			return i + 1;
+		} else if (data[i] == '\\') {
+			i += 2;
+		} else {
+			i += 1;
+		}
+	}
+
+	return size;
+}
+
+size_t StructuralIndex::skipRawString(
+	const unsigned char *data, size_t size, size_t i)
+{
+	i += 1; // 'r'
+	size_t hashes = 0;
+	while (i < size && data[i] == '#') {
+		hashes += 1;
+		i += 1;
+	}
+	i += 1; // '"'
+
+	while (i < size) {
+		auto *quote = (const unsigned char *)memchr(data + i, '"', size - i);
+		if (!quote) {
+			break;
+		}
+
+		i = quote - data + 1;
+		size_t found = 0;
+		while (found < hashes && i < size && data[i] == '#') {
+			found += 1;
+			i += 1;
+		}
+
+		if (found == hashes) {
+			return i;
+		}
+	}
+
+	return size;
+}
+
+size_t StructuralIndex::skipBlockComment(
+	const unsigned char *data, size_t size, size_t i)
+{
+	i += 2; // '/*'
+	size_t idx = findBlockCommentEnd(data + i, size - i);
+	return idx < size - i ? i + idx + 2 : size;
+}
+
+// Skip past the next '\n'
+size_t StructuralIndex::skipLine(
+	const unsigned char *data, size_t size, size_t i)
+{
+	auto *nl = (const unsigned char *)memchr(data + i, '\n', size - i);
+	return nl ? nl - data + 1 : size;
+}
+
+void StructuralIndex::build(const unsigned char *data, size_t size)
+{
+	// Characters which can be part of a number or keyword
+	static const auto bare = [] {
+		std::array<bool, 256> table{};
+		for (int ch = 0; ch < 256; ++ch) {
+			table[ch] =
+				(ch >= 'a' && ch <= 'z') ||
+				(ch >= 'A' && ch <= 'Z') ||
+				(ch >= '0' && ch <= '9') ||
+				ch == '_' || ch == '-' || ch == '+' || ch == '.' || ch == '\'';
+		}
+		return table;
+	}();
+
+	sizes_.clear();
+	stack_.clear();
+	next_ = 0;
+
+	stack_.push_back({none, false, false});
+
+	size_t i = 0;
+	while (i < size) {
+		unsigned char ch = data[i];
+		switch (ch) {
+		case ' ': case '\t': case '\r':
+			// Most runs of spaces are a single space
+			i += 1;
+			if (i < size && isSpace(data[i])) {
+				i += scanSpace(data + i, size - i);
+			}
+			break;
+
+		case '\n':
+			separator();
+			i += 1;
+			break;
+
+		case ',':
+			stack_.back().inElement = false;
+			stack_.back().afterColon = false;
+			i += 1;
+			break;
+
+		case ':':
+			// A key at the top level makes the document an object
+			if (stack_.size() == 1 && stack_.back().entry == none) {
+				stack_.back().entry = sizes_.size();
+				sizes_.push_back(1);
+			}
+			stack_.back().afterColon = true;
+			i += 1;
+			break;
+
+		case '[': case '{':
+			startContent();
+			stack_.push_back({sizes_.size(), false, false});
+			sizes_.push_back(0);
+			i += 1;
+			break;
+
+		case ']': case '}':
+			if (stack_.size() > 1) {
+				stack_.pop_back();
+			}
+			i += 1;
+			break;
+
+		case '"':
+			startContent();
+			i = skipString(data, size, i);
+			break;
+
+		case '|':
+			// A multi-line string goes on for as long as the lines
+			// after it start with '|', and it counts as having
+			// a separator after it
+			startContent();
+			while (true) {
+				i = skipLine(data, size, i);
+				while (i < size) {
+					if (isWhitespace(data[i])) {
+						i += 1;
+					} else if (data[i] == '/' && i + 1 < size && data[i + 1] == '/') {
+						i = skipLine(data, size, i);
+					} else if (data[i] == '/' && i + 1 < size && data[i + 1] == '*') {
+						i = skipBlockComment(data, size, i);
+					} else {
+						break;
+					}
+				}
+
+				if (i >= size || data[i] != '|') {
+					break;
+				}
+			}
+			separator();
+			break;
+
+		case '/':
+			if (i + 1 < size && data[i + 1] == '/') {
+				separator();
+				i = skipLine(data, size, i);
+			} else if (i + 1 < size && data[i + 1] == '*') {
+				i = skipBlockComment(data, size, i);
+			} else {
+				startContent();
+				i += 1;
+			}
+			break;
+
+		case 'r':
+			if (i + 1 < size && (data[i + 1] == '"' || data[i + 1] == '#')) {
+				startContent();
+				i = skipRawString(data, size, i);
+				break;
+			}
+			// Fall through
+
+		default:
+			// Anything else is a keyword, number or binary string prefix
+			startContent();
+			i += 1;
+			while (i < size && bare[data[i]]) {
+				i += 1;
+			}
+			break;
+		}
+	}
+}
+
+}
@@ -0,0 +1,69 @@
+#include "keys.h"
+
+#include <mutex>
+
+namespace Mason {
+
+bool isBareKey(std::string_view key)
+{
+	if (key.empty()) {
+		return false;
+	}
+
+	unsigned char ch = key[0];
+	bool isValidIdent =
+		(ch >= 'a' && ch <= 'z') ||
+		(ch >= 'A' && ch <= 'Z') ||
+		ch == '_';
+	if (!isValidIdent) {
+		return false;
+	}
+
+	for (unsigned char ch: key) {
+		isValidIdent =
+			(ch >= 'a' && ch <= 'z') ||
+			(ch >= 'A' && ch <= 'Z') ||
+			(ch >= '0' && ch <= '9') ||
+			ch == '_' || ch == '-';
+		if (!isValidIdent) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const KeyData *KeyTable::intern(std::string_view str)
+{
+	{
+		std::shared_lock lock(mutex_);
+		auto it = index_.find(str);
+		if (it != index_.end()) {
+			return it->second;
+		}
+	}
+
+	// Another thread may have added the key since the lookup above
+	std::unique_lock lock(mutex_);
+	auto it = index_.find(str);
+	if (it != index_.end()) {
+		return it->second;
+	}
+
+	if (keys_.size() >= maxSize_) {
+		return nullptr;
+	}
+
+	KeyData &data = keys_.emplace_back(
+		KeyData{std::string(str), StringHash{}(str), isBareKey(str)});
+	index_.emplace(data.str, &data);
+	return &data;
+}
+
+size_t KeyTable::size() const
+{
+	std::shared_lock lock(mutex_);
+	return keys_.size();
+}
+
+}
@@ -1,1166 +1,926 @@
-#include "mason.h"
-
+#include "codec.h"
+#include "index.h"
+#include "keys.h"
+#include "parser.h"
+#include "writer.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <charconv>
+#include <condition_variable>
 #include <iostream>
-#include <stdint.h>
+#include <mutex>
+#include <thread>
 
 namespace Mason {
 
-struct Location {
-	int line = 1;
-	int ch = 1;
+// Where an undecoded value is in the input.
+// Values are decoded once, by whichever thread gets to them first,
+// and the result of that is kept for the others.
+struct Value::Lazy {
+	Lazy(
+		std::string_view input, Reader::Position start, size_t end,
+		int depth, const char *sepError, KeyTable *keys):
+		input(input), start(start), end(end),
+		depth(depth), sepError(sepError), keys(keys) {}
+
+	std::string_view input;
+	Reader::Position start;
+	size_t end; // Where skipping over the value ended
+	int depth;
+	const char *sepError; // The error for a value which ends too soon
+	KeyTable *keys;
+
+	mutable std::once_flag loaded;
+	mutable bool ok = false;
+	mutable String err;
+	mutable Value value;
 };
 
-class Reader {
+// Builds a tree of Values.
+// Whatever the tree already contains is reused where possible,
+// so that parsing into the same Value again doesn't have to
+// allocate everything from scratch.
+class ValueBuilder {
 public:
-	Reader(std::istream &is): is_(is)  {
-		fill();
-	}
+	// Object keys are interned in the key table, if there is one
+	ValueBuilder(Value &root, KeyTable *keys = nullptr):
+		root_(&root), keys_(keys) {}
 
-	int peek() { return peekN(0); }
-	int peek2() { return peekN(1); }
+	// Build a tree where only the root is decoded,
+	// and everything inside it is left for Value::load
+	ValueBuilder(
+		Value &root, std::string_view lazyInput, KeyTable *keys = nullptr):
+		root_(&root), keys_(keys), lazy_(true), lazyInput_(lazyInput) {}
 
-	int get() {
-		int ch = peek();
-		index_ += 1;
-		loc_.ch += 1;
-		if (ch == '\n') {
-			loc_.ch = 1;
-			loc_.line += 1;
-		}
-		return ch;
+	// Start building a new tree, keeping the memory from the previous one
+	void reset(Value &root) {
+		root_ = &root;
+		stack_.clear();
+		members_.clear();
 	}
 
-	Location loc() {
-		return loc_;
+	// Drop the old object members which weren't reused,
+	// so that they don't outlive the tree they came from
+	void finish() {
+		members_.clear();
 	}
 
-private:
-	int peekN(int n = 0) {
-		if (index_ + n >= size_) {
-			fill();
-		}
+	// Reserve space for arrays and objects using the sizes in an index
+	// of the whole input
+	void setIndex(StructuralIndex *index) { index_ = index; }
 
-		if (index_ + n >= size_) {
-			return EOF;
-		}
+	// Let strings which are passed to stringView() point into the input
+	void viewStrings() { views_ = true; }
 
-		return buffer_[index_ + n];
-	}
+	String &buffer() { return buffer_; }
 
-	void fill() {
-		if (index_ > size_) {
-			return;
-		}
-
-		memmove(buffer_, buffer_ + index_, size_ - index_);
-		size_ -= index_;
-		index_ = 0;
-		size_ += is_.read((char *)buffer_ + size_, sizeof(buffer_) - size_).gcount();
+	bool null() {
+		next()->set(Null{});
+		return true;
 	}
 
-	std::istream &is_;
-	unsigned char buffer_[128];
-	size_t index_ = 0;
-	size_t size_ = 0;
-	Location loc_;
-};
-
-static bool parseValue(
-	Reader &r, Value &v, int depth,
-	String *err, bool topLevel = false);
-static void serializeValue(std::ostream &os, Value &val, int indent);
-
-static void error(Location loc, String *err, const char *what)
-{
-	if (!err) {
-		return;
+	bool boolean(Bool b) {
+		next()->set(Bool(b));
+		return true;
 	}
 
-	*err = std::to_string(loc.line);
-	*err += ':';
-	*err += std::to_string(loc.ch);
-	*err += ": ";
-	*err += what;
-}
+	bool number(Number num) {
+		next()->set(Number(num));
+		return true;
+	}
 
-static bool skipBlockComment(Reader &r, String *err)
-{
-	r.get(); // '/'
-	r.get(); // '*'
-	while (true) {
-		int ch = r.get();
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
-			return false;
-		}
+	bool number(Int num) {
+		next()->set(Int(num));
+		return true;
+	}
 
-		if (ch == '*' && r.peek() == '/') {
-			r.get();
-			return true;
-		}
+	bool number(UInt num) {
+		next()->set(UInt(num));
+		return true;
 	}
-}
 
-static bool skipWhitespace(Reader &r, String *err)
-{
-	while (true) {
-		int ch = r.peek();
-		if (ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t') {
-			r.get();
-			continue;
+	bool string() {
+		Value *v = next();
+		if (auto *str = existing<String>(v); str) {
+			str->swap(buffer_);
+		} else {
+			v->set(std::move(buffer_));
 		}
+		return true;
+	}
 
-		if (ch == '/' && r.peek2() == '/') {
-			r.get();
-			r.get();
-			while (true) {
-				ch = r.get();
-				if (ch == '\n' || ch == EOF) {
-					break;
-				}
-			}
-			continue;
+	bool stringView(std::string_view str, bool clean) {
+		Value *v = next();
+		if (views_) {
+			v->set(StringView(str, clean));
+		} else if (auto *s = existing<String>(v); s) {
+			s->assign(str);
+		} else {
+			v->set(String(str));
 		}
+		return true;
+	}
 
-		if (ch == '/' && r.peek2() == '*') {
-			if (!skipBlockComment(r, err)) {
-				return false;
-			}
-			continue;
+	bool bstring(BString &bytes) {
+		Value *v = next();
+		if (auto *bstr = existing<BString>(v); bstr) {
+			bstr->swap(bytes);
+		} else {
+			v->set(std::move(bytes));
 		}
-
-		break;
+		return true;
 	}
 
-	return true;
-}
-
-static bool skipSpace(Reader &r, String *err)
-{
-	while (true) {
-		int ch = r.peek();
-		if (ch == ' ' || ch == '\t') {
-			r.get();
-			continue;
+	bool beginArray() {
+		Value *v = next();
+		Array *arr = existing<Array>(v);
+		if (!arr) {
+			arr = &v->set(Array{});
 		}
 
-		if (ch == '/' && r.peek2() == '*') {
-			if (!skipBlockComment(r, err)) {
-				return false;
-			}
-			continue;
+		if (index_) {
+			arr->reserve(index_->nextSize());
 		}
 
-		break;
-	}
-
-	return true;
-}
-
-static bool skipSep(Reader &r, bool &foundSep, String *err)
-{
-	if (!skipSpace(r, err)) {
-		return false;
-	}
-
-	int ch = r.peek();
-
-	if (ch == ',') {
-		r.get();
-		foundSep = true;
-		return skipWhitespace(r, err);
-	}
-
-	if (ch == '\n') {
-		r.get();
-		foundSep = true;
-		return skipWhitespace(r, err);
+		stack_.push_back({arr, nullptr});
+		return true;
 	}
 
-	if (ch == '\r' && r.peek2() == '\n') {
-		r.get();
-		r.get();
-		foundSep = true;
-		return skipWhitespace(r, err);
+	bool endArray() {
+		Frame &frame = stack_.back();
+		frame.arr->resize(frame.index);
+		stack_.pop_back();
+		return true;
 	}
 
-	if (ch == '/' && r.peek2() == '/') {
-		r.get();
-		r.get();
-		foundSep = true;
-		while (true) {
-			ch = r.get();
-			if (ch == EOF || ch == '\n') {
-				return true;
+	bool beginObject() {
+		Value *v = next();
+		Object *obj = existing<Object>(v);
+		if (obj) {
+			// Keep the old members around to be reused for new ones,
+			// with the first one on top
+			for (auto it = obj->end(); it != obj->begin();) {
+				members_.push_back(std::move(*--it));
 			}
-		}
-	}
-
-	foundSep = false;
-	return true;
-}
-
-static bool parseHex(Reader &r, int n, uint32_t &ret, String *err)
-{
-	uint32_t num = 0;
-	while (n > 0) {
-		auto loc = r.loc();
-		int ch = r.get();
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
-			return false;
-		}
-
-		num *= 16;
-		if (ch >= '0' && ch <= '9') {
-			num += ch - '0';
-		} else if (ch >= 'a' && ch <= 'f') {
-			num += ch - 'a' + 10;
-		} else if (ch >= 'A' && ch <= 'F') {
-			num += ch - 'A' + 10;
+			obj->clear();
 		} else {
-			error(loc, err, "Invalid hex character");
-			return false;
+			obj = &v->set(Object{});
 		}
 
-		n -= 1;
-	}
-
-	ret = num;
-	return true;
-}
-
-static bool parseIdentifier(Reader &r, String &ident, String *err)
-{
-	int ch = r.peek();
-	if (ch == EOF) {
-		error(r.loc(), err, "Unexpected EOF");
-		return false;
-	}
-
-	auto isFirstIdent = [](char ch) {
-		return
-			(ch >= 'a' && ch <= 'z') ||
-			(ch >= 'A' && ch <= 'Z') ||
-			ch == '_';
-	};
-	if (!isFirstIdent(ch)) {
-		error(r.loc(), err, "Unexpected character for identifier");
-		return false;
-	}
-
-	auto isIdent = [](char ch) {
-		return
-			(ch >= 'a' && ch <= 'z') ||
-			(ch >= 'A' && ch <= 'Z') ||
-			(ch >= '0' && ch <= '9') ||
-			ch == '_' || ch == '-';
-	};
-
-	ident = "";
-
-	do {
-		ident += r.get();
-	} while (isIdent(r.peek()));
-	return true;
-}
+		if (index_) {
+			obj->reserve(index_->nextSize());
+		}
 
-template<typename T>
-static bool parseStringEscapeChar(char ch, T &str) {
-	if (ch == '"') {
-		str.push_back('"');
-		return true;
-	} else if (ch == '\\') {
-		str.push_back('\\');
-		return true;
-	} else if (ch == '/') {
-		str.push_back('/');
-		return true;
-	} else if (ch == 'b') {
-		str.push_back('\b');
+		stack_.push_back({nullptr, obj});
 		return true;
-	} else if (ch == 'f') {
-		str.push_back('\f');
-		return true;
-	} else if (ch == 'n') {
-		str.push_back('\n');
-		return true;
-	} else if (ch == 'r') {
-		str.push_back('\r');
-		return true;
-	} else if (ch == 't') {
-		str.push_back('\t');
-		return true;
-	}
-
-	return false;
-}
-
-static void writeUTF8(uint32_t num, String &str)
-{
-	if (num >= 0x10000u) {
-		str += 0xf0u | ((num & 0x1c0000u) >> 18u);
-		str += 0x80u | ((num & 0x03f000u) >> 12u);
-		str += 0x80u | ((num & 0x000fc0u) >> 6u);
-		str += 0x80u | ((num & 0x00003fu) >> 0u);
-	} else if (num >= 0x0800u) {
-		str += 0xe0u | ((num & 0x00f000u) >> 12u);
-		str += 0x80u | ((num & 0x000fc0u) >> 6u);
-		str += 0x80u | ((num & 0x00003fu) >> 0u);
-	} else if (num >= 0x0080u) {
-		str += 0xc0u | ((num & 0x0007c0u) >> 6);
-		str += 0x80u | ((num & 0x00003fu) >> 0);
-	} else {
-		str += num;
-	}
-}
-
-static bool parseStringEscape(Reader &r, String &str, String *err)
-{
-	int ch = r.get();
-	if (ch == EOF) {
-		error(r.loc(), err, "Unexpected EOF");
-		return false;
 	}
 
-	if (parseStringEscapeChar(ch, str)) {
+	bool key() {
+		keyData_ = keys_ ? keys_->intern(buffer_) : nullptr;
+		if (!keyData_) {
+			key_.swap(buffer_);
+		}
 		return true;
 	}
 
-	if (ch == 'x') {
-		unsigned int num;
-		if (!parseHex(r, 2, num, err)) {
-			return false;
-		}
-
-		str += (char)num;
+	bool endObject() {
+		stack_.pop_back();
 		return true;
 	}
 
-	if (ch == 'u') {
-		uint32_t codepoint;
-		auto loc = r.loc();
-		if (!parseHex(r, 4, codepoint, err)) {
-			return false;
-		}
-
-		if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
-			if (r.peek() != '\\' || r.peek2() != 'u') {
-				error(loc, err, "Unpaired UTF-16 surrogate pair");
-				return false;
+	// Decode a value which was deferred by a lazy parse.
+	// Its children are deferred again if lazyChildren is true.
+	// Skipping a value doesn't validate it, so the value must also
+	// end where skipping it did: "1_0" is skipped as one token,
+	// but only the "1" is a number.
+	static bool load(const Value::Lazy &lazy, bool lazyChildren, String *err) {
+		std::call_once(lazy.loaded, [&] {
+			Reader r(lazy.input.data(), lazy.input.size());
+			r.seek(lazy.start);
+			ValueBuilder b(lazy.value, lazy.input, lazy.keys);
+			b.lazy_ = lazyChildren;
+			lazy.ok =
+				parseValue(r, b, lazy.depth, &lazy.err) &&
+				b.checkReplaced(&lazy.err);
+			if (lazy.ok && r.pos().offset != lazy.end) {
+				error(r.loc(), &lazy.err, lazy.sepError);
+				lazy.ok = false;
 			}
 
-			r.get();
-			r.get();
-			loc = r.loc();
-			uint32_t low;
-			if (!parseHex(r, 4, low, err)) {
-				return false;
+			if (!lazy.ok) {
+				lazy.value.set(Null{});
 			}
+		});
 
-			if (low < 0xdc00 || low > 0xdfff) {
-				error(loc, err, "Unpaired UTF-16 surrogate pair");
-				return false;
-			}
-
-			codepoint = (codepoint - 0xd800) * 0x400;
-			codepoint += low - 0xDC00;
-			codepoint += 0x10000;
-		} else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) {
-			error(loc, err, "Unexpected low UTF-16 surrogate pair");
-			return false;
+		if (!lazy.ok && err) {
+			*err = lazy.err;
 		}
-
-		writeUTF8(codepoint, str);
-		return true;
+		return lazy.ok;
 	}
 
-	if (ch == 'U') {
-		uint32_t codepoint;
-		auto loc = r.loc();
-		if (!parseHex(r, 6, codepoint, err)) {
-			return false;
+	// Decode a value which was deferred by a lazy parse,
+	// along with everything inside it, and drop its record
+	static bool loadAll(Value &v) {
+		if (!v.isLazy()) {
+			return true;
 		}
 
-		if (codepoint >= 0xd800 && codepoint <= 0xdfff) {
-			error(loc, err, "UTF-16 surrogate pair escapes are not allowed");
+		Value::LazyPtr lazy = std::get<Value::LazyPtr>(v.v_);
+		if (!load(*lazy, false, nullptr)) {
 			return false;
 		}
 
-		writeUTF8(codepoint, str);
+		v.v_ = std::move(lazy->value.v_);
 		return true;
 	}
 
-	error(r.loc(), err, "Unknown escape character");
-	return false;
-}
-
-static bool parseString(Reader &r, String &str, String *err) 
-{
-	str = "";
-	r.get(); // '"'
-
-	while (true) {
-		int ch = r.get();
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
+	bool defer(Reader &r, int depth) {
+		if (!lazy_ || stack_.empty()) {
 			return false;
 		}
 
-		if (ch == '"') {
-			return true;
-		}
+		deferredStart_ = r.pos();
+		deferredDepth_ = depth;
+		deferred_ = next();
+		return true;
+	}
 
-		if (ch == '\\') {
-			if (!parseStringEscape(r, str, err)) {
-				return false;
-			}
+	// Remember where a deferred value ended, after it's been skipped
+	void deferred(Reader &r) {
+		const char *sepError = stack_.back().arr ?
+			"Expected separator or ']'" :
+			"Expected separator, '}' or EOF";
+		deferred_->v_ = std::make_shared<Value::Lazy>(
+			lazyInput_, deferredStart_, r.pos().offset,
+			deferredDepth_, sepError, keys_);
+	}
 
-			continue;
+	// Check the values which were deferred and then replaced
+	// by a later value with the same key, which would otherwise
+	// never be decoded
+	bool checkReplaced(String *err) {
+		bool ok = true;
+		for (auto &lazy: replaced_) {
+			ok = ok && load(*lazy, false, err);
 		}
+		replaced_.clear();
+		return ok;
+	}
 
-		if (ch < 0x20) {
-			error(r.loc(), err, "Unexpected control character");
-			return false;
-		}
+private:
+	struct Frame {
+		Array *arr;
+		Object *obj;
+		size_t index = 0;
+	};
 
-		str += ch;
+	// Get the value of type T which v already holds, if any
+	template<typename T>
+	static T *existing(Value *v) {
+		return std::get_if<T>(&v->v_);
 	}
-}
 
-static bool parseBinaryString(Reader &r, BString &bytes, String *err)
-{
-	bytes.clear();
-	r.get(); // 'b'
-	r.get(); // '"'
-
-	while (true) {
-		auto loc = r.loc();
-		int ch = r.get();
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
-			return false;
+	// An object member is about to be replaced by a later one
+	// with the same key
+	void replace(std::shared_ptr<Value> &val) {
+		if (lazy_ && val && val->isLazy()) {
+			replaced_.push_back(std::get<Value::LazyPtr>(val->v_));
 		}
+	}
 
-		if (ch == '"') {
-			return true;
+	// Get the Value which the next event should fill in
+	Value *next() {
+		if (stack_.empty()) {
+			return root_;
 		}
 
-		if (ch == '\\') {
-			ch = r.get();
-			if (ch == EOF) {
-				error(r.loc(), err, "Unexpected EOF");
-				return false;
+		Frame &frame = stack_.back();
+		std::shared_ptr<Value> *val;
+		if (frame.arr) {
+			Array &arr = *frame.arr;
+			if (frame.index == arr.size()) {
+				arr.push_back(nullptr);
 			}
-
-			if (ch == 'x') {
-				uint32_t num;
-				if (!parseHex(r, 2, num, err)) {
-					return false;
-				}
-				bytes.push_back(num);
-				continue;
+			val = &arr[frame.index++];
+		} else if (members_.empty()) {
+			Key key = keyData_ ? Key(keyData_) : Key(std::move(key_));
+			auto res = frame.obj->emplace(std::move(key), nullptr);
+			val = &res.first->second;
+			if (!res.second) {
+				replace(*val);
 			}
-
-			if (!parseStringEscapeChar(ch, bytes)) {
-				error(r.loc(), err, "Unknown escape character");
-				return false;
+		} else {
+			// A duplicate key is left where it first appeared,
+			// and the last value wins
+			auto &member = members_.back();
+			member.first.data_ = keyData_;
+			if (keyData_) {
+				member.first.str_.clear();
+			} else {
+				member.first.str_.swap(key_);
+			}
+			auto res = frame.obj->insert(std::move(member));
+			val = &res.first->second;
+			if (res.second) {
+				members_.pop_back();
+			} else {
+				replace(*val);
 			}
-
-			continue;
 		}
 
-		if (ch > 127) {
-			error(loc, err, "Binary strings can only contain ASCII");
-			return false;
-		} else if (ch < 0x20) {
-			error(loc, err, "Unexpected control character");
-			return false;
+		// Values which are still referenced elsewhere are left alone
+		if (!*val || val->use_count() != 1) {
+			*val = Value::makeNull();
 		}
 
-		bytes.push_back(ch);
+		return val->get();
 	}
-}
-
-static bool parseMultiLineString(Reader &r, String &str, String *err)
-{
-	str.clear();
-	r.get(); // '|'
 
-	while (true) {
-		while (true) {
-			int ch = r.get();
-			if (ch == EOF || ch == '\n' || (ch == '\r' && r.peek2() == '\n')) {
-				break;
-			}
+	Value *root_;
+	KeyTable *keys_;
+	bool lazy_ = false;
+	std::string_view lazyInput_;
+	Value *deferred_ = nullptr;
+	Reader::Position deferredStart_;
+	int deferredDepth_ = 0;
+	std::vector<Value::LazyPtr> replaced_;
+	StructuralIndex *index_ = nullptr;
+	bool views_ = false;
+	std::vector<Frame> stack_;
+	std::vector<Object::value_type> members_;
+	String buffer_;
+	String key_;
+	const KeyData *keyData_ = nullptr;
+};
 
-			str += ch;
-		}
+static void serializeValue(Writer &w, Value &val, int indent);
 
-		if (!skipWhitespace(r, err)) {
-			return false;
-		}
-
-		if (r.peek() == '|') {
-			r.get();
-			str += '\n';
-		} else {
-			return true;
-		}
-	}
+bool parse(
+	std::istream &is, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
+{
+	Reader r(is);
+	ValueBuilder b(v, keys);
+	return parseDocument(r, b, err, maxDepth);
 }
 
-static bool parseRawString(Reader &r, String &str, String *err)
+static bool parseBuffer(
+	const char *data, size_t size, Value &v,
+	String *err, int maxDepth, KeyTable *keys,
+	StructuralIndex *index = nullptr, bool views = false)
 {
-	str.clear();
-	r.get(); // 'r'
-
-	int hashes = 0;
-	int ch;
-	while ((ch = r.get()) == '#') {
-		hashes += 1;
-	}
-	if (ch != '"') {
-		error(r.loc(), err, "Expected '\"'");
-		return false;
-	}
-
-	int hashState = -1;
-	while (true) {
-		ch = r.get();
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
-			return false;
-		}
-
-		str += ch;
-		if (ch == '"') {
-			hashState = 0;
-		} else if (ch == '#' && hashState >= 0) {
-			hashState += 1;
-		} else {
-			hashState = -1;
-		}
-
-		if (hashState == hashes) {
-			str.resize(str.size() - hashes - 1);
-			return true;
-		}
+	Reader r(data, size);
+	ValueBuilder b(v, keys);
+	b.setIndex(index);
+	if (views) {
+		b.viewStrings();
 	}
+	return parseDocument(r, b, err, maxDepth);
 }
 
-static bool charValue(int ch, int &num)
+bool parse(
+	std::string_view str, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
 {
-	if (ch >= '0' && ch <= '9') {
-		num = ch - '0';
-		return true;
-	} else if (ch >= 'a' && ch <= 'f') {
-		num = ch - 'a' + 10;
-		return true;
-	} else if (ch >= 'A' && ch <= 'F') {
-		num = ch - 'A' + 10;
-		return true;
-	}
-
-	return false;
+	return parseBuffer(str.data(), str.size(), v, err, maxDepth, keys);
 }
 
-static bool parseInteger(Reader &r, double &ret, int radix, String *err)
+bool parse(
+	const char *data, size_t size, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
 {
-	int digit;
-
-	auto loc = r.loc();
-	if (!charValue(r.peek(), digit)) {
-		error(loc, err, "Expected digit");
-		return false;
-	}
-
-	if (digit >= radix) {
-		error(loc, err, "Invalid digit");
-		return false;
-	}
-
-	r.get();
-	double num = digit;
-	while (true) {
-		int ch = r.peek();
-		if (ch == EOF) {
-			ret = num;
-			return true;
-		}
-
-		if (ch == '\'') {
-			r.get();
-			continue;
-		}
-
-		if (!charValue(ch, digit)) {
-			ret = num;
-			return true;
-		}
-
-		if (digit >= radix) {
-			ret = num;
-			return true;
-		}
-
-		num *= radix;
-		num += digit;
-		r.get();
-	}
+	return parseBuffer(data, size, v, err, maxDepth, keys);
 }
 
-static bool parseNumber(Reader &r, Number &ret, String *err)
+bool parseIndexed(
+	std::string_view str, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
 {
-	auto loc = r.loc();
-	const char *sign = "";
-	int ch = r.peek();
-	if (ch == '-') {
-		sign = "-";
-		r.get();
-		ch = r.peek();
-	} else if (ch == '+') {
-		r.get();
-		ch = r.peek();
-	}
-
-	int radix = 10;
-	if (ch == '0') {
-		int ch2 = r.peek2();
-		if (ch2 == 'x') {
-			radix = 16;
-			r.get();
-			r.get();
-			ch = r.peek();
-		} else if (ch2 == 'o') {
-			radix = 8;
-			r.get();
-			r.get();
-			ch = r.peek();
-		} else if (ch2 == 'b') {
-			radix = 2;
-			r.get();
-			r.get();
-			ch = r.peek();
-		}
-	}
-
-	double integral = 0;
-	if (ch != '.') {
-		if (!parseInteger(r, integral, radix, err)) {
-			return false;
-		}
-		ch = r.peek();
-	}
-
-	std::string fractional;
-	if (radix == 10 && ch == '.') {
-		r.get();
-		fractional += '.';
-
-		ch = r.peek();
-		if (!(ch >= '0' && ch <= '9')) {
-			error(r.loc(), err, "Expected digit");
-			return false;
-		}
-
-		while (true) {
-			int ch = r.peek();
-			if (ch == '\'') {
-				r.get();
-				continue;
-			}
-
-			if (ch >= '0' && ch <= '9') {
-				fractional += ch;
-				r.get();
-				continue;
-			}
+	StructuralIndex index;
+	index.build((const unsigned char *)str.data(), str.size());
+	return parseBuffer(str.data(), str.size(), v, err, maxDepth, keys, &index);
+}
 
-			break;
-		}
+bool parseInPlace(
+	std::string_view str, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
+{
+	return parseBuffer(
+		str.data(), str.size(), v, err, maxDepth, keys, nullptr, true);
+}
 
-		ch = r.peek();
-	}
+StreamParser::StreamParser(std::istream &is, int maxDepth, KeyTable *keys):
+	reader_(new Reader(is)), maxDepth_(maxDepth), keys_(keys) {}
 
-	double exponent = 0;
-	if (radix == 10 && (ch == 'e' || ch == 'E')) {
-		r.get();
-		ch = r.peek();
-		int exponentSign = 1;
-		if (ch == '-') {
-			exponentSign = -1;
-			r.get();
-			ch = r.peek();
-		} else if (ch == '+') {
-			r.get();
-			ch = r.peek();
-		}
+StreamParser::StreamParser(
+	std::string_view str, int maxDepth, KeyTable *keys):
+	reader_(new Reader(str.data(), str.size())),
+	maxDepth_(maxDepth), keys_(keys) {}
 
-		if (!parseInteger(r, exponent, 10, err)) {
-			return false;
-		}
+StreamParser::~StreamParser() = default;
 
-		if (exponentSign < 0) {
-			exponent = -exponent;
-		}
+bool StreamParser::next(Value &v)
+{
+	Reader &r = *reader_;
+	if (!err_.empty() || !skipWhitespace(r, &err_) || r.peek() == EOF) {
+		return false;
 	}
 
-	char number[256];
-	int n = snprintf(
-		number, sizeof(number), "%s%.0f%se%.0f",
-		sign, integral, fractional.c_str(), exponent);
-	if (size_t(n) >= sizeof(number)) {
-		error(loc, err, "Number too long");
-		return false;
+	// The builder is kept between documents for its buffers
+	if (builder_) {
+		builder_->reset(v);
+	} else {
+		builder_.reset(new ValueBuilder(v, keys_));
 	}
 
-	char *ep;
-	ret = strtod(number, &ep);
-	return true;
+	bool ok = parseValue(r, *builder_, maxDepth_, &err_);
+	builder_->finish();
+	return ok;
 }
 
-static bool parseKey(Reader &r, String &key, String *err)
+bool parseLazy(
+	std::string_view str, Value &v,
+	String *err, int maxDepth, KeyTable *keys)
 {
-	if (r.peek() == '"') {
-		return parseString(r, key, err);
-	} else {
-		return parseIdentifier(r, key, err);
-	}
+	Reader r(str.data(), str.size());
+	ValueBuilder b(v, str, keys);
+	return parseDocument(r, b, err, maxDepth) && b.checkReplaced(err);
 }
 
-static bool parseKeyValuePairsAfterKey(
-	Reader &r, String key, Object &obj, int depth, String *err)
+bool Value::loadLazy(String *err) const
 {
-	obj.clear();
-
-	size_t index = 0;
-	while (true) {
-		if (r.peek() != ':') {
-			error(r.loc(), err, "Expected ':'");
-			return false;
-		}
-		r.get();
-
-		if (!skipWhitespace(r, err)) {
-			return false;
-		}
-
-		// If the next value is a multi-line string,
-		// always assume that we have had a separator
-		bool hasSep = r.peek() == '|';
-
-		auto &val = obj[std::move(key)] = Value::makeNull();
-		val->index(index++);
-		if (!parseValue(r, *val, depth, err)) {
-			return false;
-		}
+	return ValueBuilder::load(*std::get<LazyPtr>(v_), true, err);
+}
 
-		bool realHasSep;
-		if (!skipSep(r, realHasSep, err)) {
-			return false;
-		}
-		hasSep = hasSep || realHasSep;
+Value::V &Value::lazyValue() const
+{
+	const Lazy &lazy = *std::get<LazyPtr>(v_);
+	ValueBuilder::load(lazy, true, nullptr);
+	return lazy.value.v_;
+}
 
-		if (!skipWhitespace(r, err)) {
-			return false;
+// Parse the elements of the value's array or object, which were deferred
+// by a lazy parse, on a pool of threads
+static bool loadChildren(Value &v, unsigned threads)
+{
+	std::vector<Value *> children;
+	if (auto *arr = v.as<Array>(); arr) {
+		for (auto &child: *arr) {
+			children.push_back(child.get());
 		}
-
-		int ch = r.peek();
-		if (ch == '}' || ch == EOF) {
-			return true;
+	} else if (auto *obj = v.as<Object>(); obj) {
+		for (auto &[key, child]: *obj) {
+			children.push_back(child.get());
 		}
+	}
 
-		if (!hasSep) {
-			error(r.loc(), err, "Expected separator, '}' or EOF");
-			return false;
-		}
+	threads = std::min<size_t>(threads, (children.size() + 63) / 64);
 
-		key.clear();
-		if (!parseKey(r, key, err)) {
-			return false;
-		}
+	// Workers take batches of elements until there are none left
+	std::atomic<size_t> nextIndex(0);
+	std::atomic<bool> ok(true);
+	auto work = [&] {
+		while (ok) {
+			size_t start = nextIndex.fetch_add(64);
+			if (start >= children.size()) {
+				return;
+			}
 
-		if (!skipWhitespace(r, err)) {
-			return false;
+			size_t end = std::min(start + 64, children.size());
+			for (size_t i = start; i < end; ++i) {
+				if (!ValueBuilder::loadAll(*children[i])) {
+					ok = false;
+					return;
+				}
+			}
 		}
-	}
-}
+	};
 
-static bool parseKeyValuePairs(Reader &r, Object &obj, int depth, String *err)
-{
-	String key;
-	if (!parseKey(r, key, err)) {
-		return false;
+	std::vector<std::thread> pool;
+	for (unsigned i = 1; i < threads; ++i) {
+		pool.emplace_back(work);
 	}
-
-	if (!skipWhitespace(r, err)) {
-		return false;
+	work();
+	for (auto &thread: pool) {
+		thread.join();
 	}
 
-	return parseKeyValuePairsAfterKey(r, std::move(key), obj, depth, err);
+	return ok;
 }
 
-static bool parseObject(Reader &r, Object &obj, int depth, String *err)
+bool parseParallel(
+	std::string_view str, Value &v,
+	String *err, int maxDepth, unsigned threads, KeyTable *keys)
 {
-	if (r.peek() != '{') {
-		error(r.loc(), err, "Expected '{'");
-		return false;
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
 	}
-	r.get();
 
-	if (!skipWhitespace(r, err)) {
-		return false;
+	if (threads <= 1) {
+		return parse(str, v, err, maxDepth, keys);
 	}
 
-	if (r.peek() == '}') {
-		r.get();
+	// The first pass finds where each top-level element starts
+	// and skips over it, which is much faster than parsing it
+	Reader r(str.data(), str.size());
+	ValueBuilder b(v, str, keys);
+	if (
+			parseDocument(r, b, nullptr, maxDepth) &&
+			b.checkReplaced(nullptr) && loadChildren(v, threads)) {
 		return true;
 	}
 
-	if (!parseKeyValuePairs(r, obj, depth, err)) {
-		return false;
-	}
-
-	if (!skipWhitespace(r, err)) {
-		return false;
-	}
-
-	if (r.peek() != '}') {
-		error(r.loc(), err, "Expected '{'");
-		return false;
-	}
-	r.get();
-	return true;
+	// Skipping doesn't validate the elements, so the error might
+	// have been found in an odd place; parse it all again
+	// to get the same error as parse() would
+	ValueBuilder retry(v, keys);
+	Reader r2(str.data(), str.size());
+	return parseDocument(r2, retry, err, maxDepth);
 }
 
-static bool parseArray(Reader &r, Array &arr, int depth, String *err)
+static void serializeString(Writer &w, std::string_view str)
 {
-	if (r.peek() != '[') {
-		error(r.loc(), err, "Expected '['");
-		return false;
-	}
-	r.get();
-
-	if (!skipWhitespace(r, err)) {
-		return false;
-	}
-
-	if (r.peek() == ']') {
-		r.get();
-		return true;
-	}
-
-	size_t index = 0;
+	w.put('"');
+	size_t i = 0;
 	while (true) {
-		if (!skipWhitespace(r, err)) {
-			return false;
-		}
-
-		// If the next value is a multi-line string,
-		// always assume that we have had a separator
-		bool hasSep = r.peek() == '|';
-
-		arr.push_back(Value::makeNull());
-		arr.back()->index(index++);
-		if (!parseValue(r, *arr.back(), depth, err)) {
-			return false;
-		}
-
-		bool realHasSep;
-		if (!skipSep(r, realHasSep, err)) {
-			return false;
-		}
-		hasSep = hasSep | realHasSep;
-
-		int ch = r.peek();
-		if (ch == ']') {
-			r.get();
-			return true;
-		}
-
-		if (ch == EOF) {
-			error(r.loc(), err, "Unexpected EOF");
-			return false;
+		// Copy everything up to the next character
+		// which might need escaping in one go
+		size_t idx = findStringSpecial(
+			(const unsigned char *)str.data() + i, str.size() - i);
+		w.write(str.data() + i, idx);
+		i += idx;
+		if (i == str.size()) {
+			break;
 		}
 
-		if (!hasSep) {
-			error(r.loc(), err, "Expected separator or ']'");
-			return false;
+		char ch = str[i++];
+		if (ch == '"' || ch == '\\') {
+			w.put('\\');
+			w.put(ch);
+		} else if (ch == '\n') {
+			w.write("\\n");
+		} else if (ch == '\r') {
+			w.write("\\r");
+		} else if (ch == '\t') {
+			w.write("\\t");
+		} else {
+			w.put(ch);
 		}
 	}
+	w.put('"');
 }
 
-static bool parseValue(
-	Reader &r, Value &v, int depth,
-	String *err, bool topLevel)
+static void serializeBString(Writer &w, const BString &bytes)
 {
-	if (depth <= 0) {
-		error(r.loc(), err, "Nesting limit exceeded");
-		return false;
-	}
-
-	int ch = r.peek();
-	if (ch == EOF) {
-		error(r.loc(), err, "Unexpected EOF");
-		return false;
-	}
-
-	if (ch == '[') {
-		return parseArray(r, v.set(Array{}), depth - 1, err);
-	} else if (ch == '{') {
-		return parseObject(r, v.set(Object{}), depth - 1, err);
-	} else if (ch == '"') {
-		String ident;
-		if (!parseString(r, ident, err)) {
-			return false;
+	// The hex escape for each byte, for bytes which need one
+	static const auto escapes = [] {
+		std::array<std::array<char, 4>, 256> table;
+		for (int i = 0; i < 256; ++i) {
+			auto ch = (unsigned char)i;
+			encodeHexEscapes(&ch, 1, table[i].data());
 		}
+		return table;
+	}();
 
-		if (topLevel) {
-			if (!skipWhitespace(r, err)) {
-				return false;
-			}
+	w.write("b\"");
+	const unsigned char *p = bytes.data();
+	size_t n = bytes.size();
+	size_t i = 0;
 
-			if (r.peek() == ':') {
-				return parseKeyValuePairsAfterKey(
-					r, std::move(ident), v.set(Object{}),
-					depth - 1, err);
-			}
+	// Build the output in blocks of 16 bytes, copying blocks which are
+	// all printable as they are, and escaping the others byte by byte
+	char buf[1024];
+	size_t len = 0;
+	while (i < n) {
+		if (len > sizeof(buf) - 64) {
+			w.write(buf, len);
+			len = 0;
 		}
 
-		v.set(std::move(ident));
-		return true;
-	} else if (ch == 'r' && (r.peek2() == '"' || r.peek2() == '#')) {
-		return parseRawString(r, v.set(String{}), err);
-	} else if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '+' || ch == '-') {
-		return parseNumber(r, v.set(Number{}), err);
-	} else if (ch == 'b' && r.peek2() == '"') {
-		return parseBinaryString(r, v.set(BString{}), err);
-	} else if (ch == '|') {
-		return parseMultiLineString(r, v.set(String{}), err);
-	}
-
-	auto loc = r.loc();
-	String ident;
-	if (!parseIdentifier(r, ident, err)) {
-		return false;
-	}
-
-	if (topLevel) {
-		if (!skipWhitespace(r, err)) {
-			return false;
+		size_t block = std::min<size_t>(n - i, 16);
+		if (findBinarySpecial(p + i, block, 0x7e) == block) {
+			memcpy(buf + len, p + i, block);
+			len += block;
+			i += block;
+			continue;
 		}
 
-		if (r.peek() == ':') {
-			return parseKeyValuePairsAfterKey(
-				r, std::move(ident), v.set(Object{}),
-				depth - 1, err);
+		for (size_t end = i + block; i < end; ++i) {
+			unsigned char ch = p[i];
+			if (ch < 0x20 || ch > 0x7e || ch == '"' || ch == '\\') {
+				memcpy(buf + len, escapes[ch].data(), 4);
+				len += 4;
+			} else {
+				buf[len++] = ch;
+			}
 		}
 	}
 
-	if (ident == "null") {
-		v.set(Null{});
-		return true;
-	} else if (ident == "true") {
-		v.set(true);
-		return true;
-	} else if (ident == "false") {
-		v.set(false);
-		return true;
-	} else if (ident.size() > 0) {
-		error(loc, err, "Unexpected keyword");
-		return false;
+	w.write(buf, len);
+	w.put('"');
+}
+
+static void serializeKey(Writer &w, const Key &key)
+{
+	if (key.bare()) {
+		w.write(key.str());
 	} else {
-		error(loc, err, "Unexpected character");
-		return false;
+		serializeString(w, key.str());
 	}
 }
 
-bool parse(
-	std::istream &is, Value &v,
-	String *err, int maxDepth)
+static void serializeIndent(Writer &w, int indent)
 {
-	Reader r(is);
-
-	if (!skipWhitespace(r, err)) {
-		return false;
+	for (int i = 0; i < indent; ++i) {
+		w.write("  ");
 	}
+}
 
-	if (!parseValue(r, v, maxDepth, err, true)) {
-		return false;
+static void serializeKeyValues(
+	Writer &w, Object::iterator first, Object::iterator last, int indent)
+{
+	for (; first != last; ++first) {
+		serializeIndent(w, indent);
+		serializeKey(w, first->first);
+		w.write(": ");
+		serializeValue(w, *first->second, indent);
+		w.put('\n');
 	}
+}
 
-	if (!skipWhitespace(r, err)) {
-		return false;
+static void serializeElements(
+	Writer &w, Array::iterator first, Array::iterator last, int indent)
+{
+	for (; first != last; ++first) {
+		serializeIndent(w, indent);
+		serializeValue(w, **first, indent);
+		w.put('\n');
 	}
+}
 
-	if (r.peek() != EOF) {
-		error(r.loc(), err, "Trailing garbage after document");
-		return false;
+static void serializeObject(Writer &w, Object &obj, int indent)
+{
+	if (obj.size() == 0) {
+		w.write("{}");
+		return;
 	}
 
-	return true;
+	w.write("{\n");
+	serializeKeyValues(w, obj.begin(), obj.end(), indent + 1);
+	w.put('}');
 }
 
-static void serializeString(std::ostream &os, const String &ident)
+static void serializeArray(Writer &w, Array &arr, int indent)
 {
-	os << '"';
-	for (char ch: ident) {
-		if (ch == '"' || ch == '\\') {
-			os << '\\' << ch;
-		} else if (ch == '\n') {
-			os << "\\n";
-		} else if (ch == '\r') {
-			os << "\\r";
-		} else if (ch == '\t') {
-			os << "\\t";
-		} else {
-			os << ch;
-		}
+	if (arr.size() == 0) {
+		w.write("[]");
+		return;
 	}
-	os << '"';
+
+	w.write("[\n");
+	serializeElements(w, arr.begin(), arr.end(), indent + 1);
+	w.put(']');
 }
 
-static void serializeBString(std::ostream &os, const BString &ident)
+template<typename T>
+static void serializeNumber(Writer &w, T num)
 {
-	const char *alphabet = "0123456789abcdef";
+	char buf[64];
+	auto res = std::to_chars(buf, &buf[sizeof(buf)], num);
+	w.write(buf, res.ptr - buf);
+}
 
-	os << "b\"";
-	for (unsigned char ch: ident) {
-		if (ch >= 32 && ch < 127) {
-			os << char(ch);
-		} else {
-			os << "\\x";
-			os << alphabet[ch >> 4];
-			os << alphabet[ch & 0x0f];
-		}
+static void serializeValue(Writer &w, Value &val, int indent)
+{
+	if (val.is<Null>()) {
+		w.write("null");
+	} else if (auto *b = val.as<Bool>(); b) {
+		w.write(*b ? "true" : "false");
+	} else if (auto *n = val.as<Number>(); n) {
+		serializeNumber(w, *n);
+	} else if (auto *i = val.as<Int>(); i) {
+		serializeNumber(w, *i);
+	} else if (auto *u = val.as<UInt>(); u) {
+		serializeNumber(w, *u);
+	} else if (auto *s = val.as<String>(); s) {
+		serializeString(w, *s);
+	} else if (auto *sv = val.as<StringView>(); sv && sv->clean) {
+		w.put('"');
+		w.write(*sv);
+		w.put('"');
+	} else if (auto *sv = val.as<StringView>(); sv) {
+		serializeString(w, *sv);
+	} else if (auto *b = val.as<BString>(); b) {
+		serializeBString(w, *b);
+	} else if (auto *a = val.as<Array>(); a) {
+		serializeArray(w, *a, indent);
+	} else if (auto *o = val.as<Object>(); o) {
+		serializeObject(w, *o, indent);
 	}
-	os << '"';
 }
 
-static void serializeKey(std::ostream &os, const String &ident)
+void serialize(Writer &w, Value &v)
 {
-	if (ident == "") {
-		os << "\"\"";
-		return;
+	if (auto *obj = v.as<Object>(); obj) {
+		serializeKeyValues(w, obj->begin(), obj->end(), 0);
+	} else {
+		serializeValue(w, v, 0);
 	}
+}
 
-	unsigned char ch = ident[0];
-	bool isValidIdent =
-		(ch >= 'a' && ch <= 'z') ||
-		(ch >= 'A' && ch <= 'Z') ||
-		ch == '_';
-	if (!isValidIdent) {
-		serializeString(os, ident);
-		return;
+void serialize(std::ostream &os, Value &v)
+{
+	Writer w(os);
+	serialize(w, v);
+}
+
+// Serializes a value on a pool of threads.
+// A first pass over the tree writes out everything except the elements
+// of large arrays and objects, which are split into ranges instead.
+// Workers serialize the ranges into buffers of their own,
+// and the calling thread writes everything out in order.
+class ParallelSerializer {
+public:
+	ParallelSerializer(unsigned threads): threads_(threads), w_(text_) {}
+
+	void value(Value &val, int indent) {
+		if (auto *arr = val.as<Array>(); arr && !arr->empty()) {
+			w_.write("[\n");
+			if (arr->size() >= splitSize) {
+				split(arr, nullptr, indent + 1);
+			} else {
+				for (auto &child: *arr) {
+					serializeIndent(w_, indent + 1);
+					value(*child, indent + 1);
+					w_.put('\n');
+				}
+			}
+			w_.put(']');
+		} else if (auto *obj = val.as<Object>(); obj && !obj->empty()) {
+			w_.write("{\n");
+			members(*obj, indent + 1);
+			w_.put('}');
+		} else {
+			serializeValue(w_, val, indent);
+		}
 	}
 
-	for (unsigned char ch: ident) {
-		isValidIdent =
-			(ch >= 'a' && ch <= 'z') ||
-			(ch >= 'A' && ch <= 'Z') ||
-			(ch >= '0' && ch <= '9') ||
-			ch == '_' || ch == '-';
-		if (!isValidIdent) {
-			serializeString(os, ident);
+	void members(Object &obj, int indent) {
+		if (obj.size() >= splitSize) {
+			split(nullptr, &obj, indent);
 			return;
 		}
+
+		for (auto &[key, val]: obj) {
+			serializeIndent(w_, indent);
+			serializeKey(w_, key);
+			w_.write(": ");
+			value(*val, indent);
+			w_.put('\n');
+		}
 	}
 
-	os << ident;
-}
+	void run(Writer &w) {
+		endSegment();
 
-static void serializeKeyValues(std::ostream &os, Object &obj, int indent)
-{
-	std::vector<std::pair<const std::string *, Value *>> values;
-	values.reserve(obj.size());
-	for (auto &[key, val]: obj) {
-		values.push_back({&key, val.get()});
-	}
+		std::mutex mutex;
+		std::condition_variable cond;
+		size_t next = 0;
+		size_t written = 0;
 
-	std::sort(values.begin(), values.end(), [](const auto &a, const auto &b) {
-		return a.second->index() < b.second->index();
-	});
+		// Workers stay within a window of segments ahead of the writer,
+		// so that the output isn't all kept in memory at once
+		size_t window = threads_ * 4;
+		auto work = [&] {
+			std::unique_lock lock(mutex);
+			while (true) {
+				while (next < segments_.size() && !segments_[next].ranged()) {
+					next += 1;
+				}
+				if (next == segments_.size()) {
+					return;
+				} else if (next >= written + window) {
+					cond.wait(lock);
+					continue;
+				}
+
+				Segment &seg = segments_[next++];
+				lock.unlock();
+				seg.serialize();
+				lock.lock();
+				seg.done = true;
+				cond.notify_all();
+			}
+		};
 
-	for (auto [key, val]: values) {
-		for (int i = 0; i < indent; ++i) {
-			os << "  ";
+		std::vector<std::thread> pool;
+		if (segments_.size() > 1) {
+			for (unsigned i = 0; i < threads_; ++i) {
+				pool.emplace_back(work);
+			}
 		}
 
-		serializeKey(os, *key);
-		os << ": ";
-		serializeValue(os, *val, indent);
-		os << '\n';
-	}
-}
+		for (size_t i = 0; i < segments_.size(); ++i) {
+			Segment &seg = segments_[i];
+			w.write(seg.text);
+			String().swap(seg.text);
+			if (seg.ranged()) {
+				std::unique_lock lock(mutex);
+				cond.wait(lock, [&] { return seg.done; });
+			}
 
-static void serializeObject(std::ostream &os, Object &obj, int indent)
-{
-	if (obj.size() == 0) {
-		os << "{}";
-		return;
-	}
+			w.write(seg.out);
+			String().swap(seg.out);
 
-	os << "{\n";
-	serializeKeyValues(os, obj, indent + 1);
-	os << '}';
-}
+			std::unique_lock lock(mutex);
+			written = i + 1;
+			cond.notify_all();
+		}
 
-static void serializeArray(std::ostream &os, Array &arr, int indent)
-{
-	if (arr.size() == 0) {
-		os << "[]";
-		return;
+		for (auto &thread: pool) {
+			thread.join();
+		}
 	}
 
-	os << "[\n";
-	indent += 1;
-	for (auto &val: arr) {
-		for (int i = 0; i < indent; ++i) {
-			os << "  ";
+private:
+	// Arrays and objects with at least this many elements are split up
+	static constexpr size_t splitSize = 64;
+
+	// Text from the first pass, followed by a range of elements or
+	// members which is serialized by a worker
+	struct Segment {
+		String text;
+		Array *arr = nullptr;
+		Object *obj = nullptr;
+		size_t start = 0;
+		size_t end = 0;
+		int indent = 0;
+		String out;
+		bool done = false;
+
+		bool ranged() const { return arr || obj; }
+
+		void serialize() {
+			Writer w(out);
+			if (arr) {
+				serializeElements(
+					w, arr->begin() + start, arr->begin() + end, indent);
+			} else {
+				serializeKeyValues(
+					w, obj->begin() + start, obj->begin() + end, indent);
+			}
 		}
+	};
 
-		serializeValue(os, *val, indent);
-		os << '\n';
-	}
-	os << ']';
-}
+	// Split the elements into a few ranges per thread
+	void split(Array *arr, Object *obj, int indent) {
+		size_t size = arr ? arr->size() : obj->size();
+		size_t ranges = threads_ * 8;
+		size_t step = (size + ranges - 1) / ranges;
+		for (size_t start = 0; start < size; start += step) {
+			Segment &seg = endSegment();
+			seg.arr = arr;
+			seg.obj = obj;
+			seg.start = start;
+			seg.end = std::min(start + step, size);
+			seg.indent = indent;
+		}
+	}
+
+	// Start a segment with the text written since the previous one
+	Segment &endSegment() {
+		w_.flush();
+		Segment &seg = segments_.emplace_back();
+		seg.text.swap(text_);
+		return seg;
+	}
+
+	unsigned threads_;
+	std::vector<Segment> segments_;
+	String text_;
+	Writer w_;
+};
 
-static void serializeNumber(std::ostream &os, Number num)
+void serializeParallel(Writer &w, Value &v, unsigned threads)
 {
-	char buf[64];
-	auto res = std::to_chars(buf, &buf[sizeof(buf) - 1], num);
-	*res.ptr = '\0';
-	os << buf;
-}
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
 
-static void serializeValue(std::ostream &os, Value &val, int indent)
-{
-	if (val.is<Null>()) {
-		os << "null";
-	} else if (auto *b = val.as<Bool>(); b) {
-		os << (*b ? "true" : "false");
-	} else if (auto *n = val.as<Number>(); n) {
-		serializeNumber(os, *n);
-	} else if (auto *s = val.as<String>(); s) {
-		serializeString(os, *s);
-	} else if (auto *b = val.as<BString>(); b) {
-		serializeBString(os, *b);
-	} else if (auto *a = val.as<Array>(); a) {
-		serializeArray(os, *a, indent);
-	} else if (auto *o = val.as<Object>(); o) {
-		serializeObject(os, *o, indent);
+	if (threads <= 1) {
+		serialize(w, v);
+		return;
 	}
-}
 
-void serialize(std::ostream &os, Value &v)
-{
+	ParallelSerializer s(threads);
 	if (auto *obj = v.as<Object>(); obj) {
-		serializeKeyValues(os, *obj, 0);
+		s.members(*obj, 0);
 	} else {
-		serializeValue(os, v, 0);
+		s.value(v, 0);
 	}
+	s.run(w);
 }
 
 }
@@ -0,0 +1,167 @@
+#include "mason.h"
+
+#include <stdexcept>
+
+namespace Mason {
+
+// The bits of a hash which are kept in a slot,
+// to avoid comparing keys which only share the lower bits
+static uint32_t slotHash(uint64_t hash)
+{
+	return uint32_t(hash >> 32);
+}
+
+Object::Object(std::initializer_list<value_type> init)
+{
+	reserve(init.size());
+	for (auto &entry: init) {
+		insert(entry);
+	}
+}
+
+void Object::reserve(size_t n)
+{
+	entries_.reserve(n);
+	if (n > indexedSize && slots_.size() < n * 2) {
+		rebuildIndex(n);
+	}
+}
+
+Object::mapped_type &Object::operator[](std::string_view key)
+{
+	size_t idx = indexOf(key);
+	if (idx != size()) {
+		return entries_[idx].second;
+	}
+
+	return insert(value_type(key, nullptr)).first->second;
+}
+
+Object::mapped_type &Object::at(std::string_view key)
+{
+	size_t idx = indexOf(key);
+	if (idx == size()) {
+		throw std::out_of_range("Mason::Object::at");
+	}
+
+	return entries_[idx].second;
+}
+
+const Object::mapped_type &Object::at(std::string_view key) const
+{
+	return const_cast<Object *>(this)->at(key);
+}
+
+std::pair<Object::iterator, bool> Object::insert(value_type &&entry)
+{
+	// Small objects don't need the hash
+	uint64_t hash = 0;
+	size_t idx;
+	if (slots_.empty()) {
+		idx = linearIndexOf(entry.first);
+	} else {
+		hash = entry.first.hash();
+		idx = hashedIndexOf(entry.first, hash);
+	}
+
+	if (idx != size()) {
+		return {begin() + idx, false};
+	}
+
+	entries_.push_back(std::move(entry));
+	if (!slots_.empty() && size() * 2 <= slots_.size()) {
+		addSlot(idx, hash);
+	} else if (size() > indexedSize) {
+		rebuildIndex(size());
+	}
+
+	return {begin() + idx, true};
+}
+
+Object::iterator Object::erase(const_iterator pos)
+{
+	size_t idx = pos - begin();
+	entries_.erase(entries_.begin() + idx);
+	if (size() > indexedSize) {
+		rebuildIndex(size());
+	} else {
+		slots_.clear();
+	}
+
+	return begin() + idx;
+}
+
+size_t Object::erase(std::string_view key)
+{
+	size_t idx = indexOf(key);
+	if (idx == size()) {
+		return 0;
+	}
+
+	erase(begin() + idx);
+	return 1;
+}
+
+size_t Object::indexOf(std::string_view key) const
+{
+	if (slots_.empty()) {
+		return linearIndexOf(key);
+	}
+
+	return hashedIndexOf(key, StringHash{}(key));
+}
+
+template<typename K>
+size_t Object::linearIndexOf(const K &key) const
+{
+	for (size_t i = 0; i < entries_.size(); ++i) {
+		if (entries_[i].first == key) {
+			return i;
+		}
+	}
+
+	return size();
+}
+
+// Look a key up in the hash index, which must exist
+template<typename K>
+size_t Object::hashedIndexOf(const K &key, uint64_t hash) const
+{
+	size_t mask = slots_.size() - 1;
+	for (size_t i = hash & mask; slots_[i].entry != 0; i = (i + 1) & mask) {
+		const Slot &slot = slots_[i];
+		if (slot.hash == slotHash(hash) && entries_[slot.entry - 1].first == key) {
+			return slot.entry - 1;
+		}
+	}
+
+	return size();
+}
+
+void Object::addSlot(size_t entry, uint64_t hash)
+{
+	size_t mask = slots_.size() - 1;
+	size_t i = hash & mask;
+	while (slots_[i].entry != 0) {
+		i = (i + 1) & mask;
+	}
+
+	slots_[i] = {uint32_t(entry + 1), slotHash(hash)};
+}
+
+// Make a new index with room for n members.
+// It's kept at most half full, so that probe sequences stay short.
+void Object::rebuildIndex(size_t n)
+{
+	size_t capacity = 16;
+	while (capacity < n * 2) {
+		capacity *= 2;
+	}
+
+	slots_.assign(capacity, {0, 0});
+	for (size_t i = 0; i < entries_.size(); ++i) {
+		addSlot(i, entries_[i].first.hash());
+	}
+}
+
+}
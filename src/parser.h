@@ -0,0 +1,1750 @@
+#pragma once
+
+// The MASON parser.
+// It reads from a Reader and reports everything it finds to a builder,
+// which turns it into some document representation.
+// A builder must provide:
+//
+//     String &buffer();  // Strings and keys are decoded into this buffer
+//     bool null();
+//     bool boolean(Bool b);
+//     bool number(Number num);
+//     bool number(Int num);
+//     bool number(UInt num);
+//     bool string();      // A string value is in buffer()
+//     bool bstring(BString &bytes);
+//     bool beginArray();
+//     bool endArray();
+//     bool beginObject();
+//     bool key();         // The next value's key is in buffer()
+//     bool endObject();
+//
+// If a callback returns false, parsing stops with an error.
+//
+// A builder may also provide
+//
+//     bool defer(Reader &r, int depth);
+//     void deferred(Reader &r);
+//
+// defer is called before each value other than the top-level one.
+// If it returns true, the value is skipped without being decoded,
+// and it's up to the builder to remember where it was.
+// deferred is then called with the reader just past the value.
+//
+// A builder may also provide
+//
+//     bool stringView(std::string_view str, bool clean);
+//
+// which is called instead of string() for a quoted string without escapes
+// or a raw string, when the input is in memory.
+// The string points into the input, and isn't copied into buffer().
+// If clean is true, the string is known to not contain any '"', '\\'
+// or control characters, so it can be serialized without escaping.
+
+#include "codec.h"
+#include "mason.h"
+#include "scan.h"
+
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdint.h>
+#include <type_traits>
+#include <utility>
+
+namespace Mason {
+
+struct Location {
+	int line = 1;
+	int ch = 1;
+};
+
+class Reader {
+public:
+	Reader(std::istream &is): data_(buffer_), is_(&is) {
+		fill();
+	}
+
+	Reader(const char *data, size_t size):
+		data_((const unsigned char *)data), size_(size) {}
+
+	int peek() {
+		if (index_ < size_) {
+			return data_[index_];
+		}
+
+		return peekSlow(0);
+	}
+
+	int peek2() {
+		if (index_ + 1 < size_) {
+			return data_[index_ + 1];
+		}
+
+		return peekSlow(1);
+	}
+
+	int get() {
+		int ch = peek();
+		index_ += 1;
+		if (ch == '\n') {
+			line_ += 1;
+			lineStart_ = offset_ + index_;
+		}
+		return ch;
+	}
+
+	Location loc() {
+		return {line_, int(offset_ + index_ - lineStart_) + 1};
+	}
+
+	// A position in the input, for coming back to it later
+	struct Position {
+		size_t offset;
+		size_t lineStart;
+		int line;
+	};
+
+	Position pos() {
+		return {offset_ + index_, lineStart_, line_};
+	}
+
+	// Jump to a position from pos().
+	// Only possible when reading from memory.
+	void seek(Position pos) {
+		index_ = pos.offset - offset_;
+		lineStart_ = pos.lineStart;
+		line_ = pos.line;
+	}
+
+	// Switch to a new in-memory buffer, which holds the input
+	// starting at the given offset. The current position must be in it.
+	void rebase(const char *data, size_t size, size_t offset) {
+		index_ = offset_ + index_ - offset;
+		offset_ = offset;
+		data_ = (const unsigned char *)data;
+		size_ = size;
+	}
+
+	// Whether the reader has tried to look past the end of the input
+	// since the last call to resetHitEnd()
+	bool hitEnd() {
+		return hitEnd_;
+	}
+
+	void resetHitEnd() {
+		hitEnd_ = false;
+	}
+
+	// Direct access to the bytes which are currently buffered,
+	// for scanning many bytes at a time.
+	// Only peek(), peek2() and get() will refill the buffer.
+	const unsigned char *cur() {
+		return data_ + index_;
+	}
+
+	size_t avail() {
+		return index_ < size_ ? size_ - index_ : 0;
+	}
+
+	// Whether the whole input is in memory, outside of the reader,
+	// so that pointers from cur() stay valid
+	bool inMemory() {
+		return data_ != buffer_;
+	}
+
+	// Consume n buffered bytes which are known to not contain a newline
+	void skip(size_t n) {
+		index_ += n;
+	}
+
+	// Consume n buffered bytes, keeping track of newlines
+	void advance(size_t n) {
+		const unsigned char *p = data_ + index_;
+		const unsigned char *end = p + n;
+		while ((p = (const unsigned char *)memchr(p, '\n', end - p))) {
+			p += 1;
+			line_ += 1;
+			lineStart_ = offset_ + (p - data_);
+		}
+
+		index_ += n;
+	}
+
+private:
+	int peekSlow(size_t n) {
+		if (!is_) {
+			hitEnd_ = true;
+			return EOF;
+		}
+
+		fill();
+		if (index_ + n >= size_) {
+			hitEnd_ = true;
+			return EOF;
+		}
+
+		return data_[index_ + n];
+	}
+
+	void fill() {
+		if (index_ > size_) {
+			return;
+		}
+
+		memmove(buffer_, buffer_ + index_, size_ - index_);
+		offset_ += index_;
+		size_ -= index_;
+		index_ = 0;
+
+		size_t want = sizeof(buffer_) - size_;
+		size_t got = is_->read((char *)buffer_ + size_, want).gcount();
+		size_ += got;
+
+		// A short read means the stream is exhausted,
+		// so the buffer is all we'll ever have
+		if (got < want) {
+			is_ = nullptr;
+		}
+	}
+
+	const unsigned char *data_;
+	size_t index_ = 0;
+	size_t size_ = 0;
+
+	// Stream state, only used when reading from an std::istream
+	std::istream *is_ = nullptr;
+	unsigned char buffer_[4096];
+
+	// Line tracking; offsets are relative to the start of the input
+	size_t offset_ = 0;
+	size_t lineStart_ = 0;
+	int line_ = 1;
+
+	bool hitEnd_ = false;
+};
+
+template<typename Builder, typename = void>
+struct CanDefer: std::false_type {};
+
+template<typename Builder>
+struct CanDefer<Builder, std::void_t<decltype(
+	std::declval<Builder &>().defer(std::declval<Reader &>(), 0))>>:
+	std::true_type {};
+
+template<typename Builder, typename = void>
+struct CanView: std::false_type {};
+
+template<typename Builder>
+struct CanView<Builder, std::void_t<decltype(
+	std::declval<Builder &>().stringView(std::string_view(), true))>>:
+	std::true_type {};
+
+template<typename Builder>
+static bool parseValue(
+	Reader &r, Builder &b, int depth,
+	String *err, bool topLevel = false);
+
+static inline void error(Location loc, String *err, const char *what)
+{
+	if (!err) {
+		return;
+	}
+
+	*err = std::to_string(loc.line);
+	*err += ':';
+	*err += std::to_string(loc.ch);
+	*err += ": ";
+	*err += what;
+}
+
+// Report that a builder asked to stop parsing
+static inline bool stopped(Reader &r, String *err)
+{
+	error(r.loc(), err, "Parsing stopped by handler");
+	return false;
+}
+
+static inline bool skipBlockComment(Reader &r, String *err)
+{
+	r.skip(2); // '/*'
+	while (true) {
+		size_t n = r.avail();
+		size_t idx = findBlockCommentEnd(r.cur(), n);
+		if (idx < n) {
+			r.advance(idx + 2);
+			return true;
+		}
+
+		// A trailing '*' might be the start of a "*/"
+		// which continues in the next buffer
+		if (n > 0 && r.cur()[n - 1] == '*') {
+			n -= 1;
+		}
+		r.advance(n);
+
+		if (r.peek2() == EOF) {
+			r.advance(r.avail());
+			r.get();
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+	}
+}
+
+// Skip a line comment, including the newline which ends it
+static inline void skipLineComment(Reader &r)
+{
+	r.skip(2); // '//'
+	while (true) {
+		size_t n = r.avail();
+		auto *nl = (const unsigned char *)memchr(r.cur(), '\n', n);
+		if (nl) {
+			r.skip(nl - r.cur());
+			r.get();
+			return;
+		}
+
+		r.skip(n);
+		if (r.peek() == EOF) {
+			r.get();
+			return;
+		}
+	}
+}
+
+static inline bool skipWhitespace(Reader &r, String *err)
+{
+	while (true) {
+		int ch = r.peek();
+		if (isWhitespace(ch)) {
+			r.advance(scanWhitespace(r.cur(), r.avail()));
+			continue;
+		}
+
+		if (ch == '/' && r.peek2() == '/') {
+			skipLineComment(r);
+			continue;
+		}
+
+		if (ch == '/' && r.peek2() == '*') {
+			if (!skipBlockComment(r, err)) {
+				return false;
+			}
+			continue;
+		}
+
+		break;
+	}
+
+	return true;
+}
+
+static inline bool skipSpace(Reader &r, String *err)
+{
+	while (true) {
+		int ch = r.peek();
+		if (isSpace(ch)) {
+			r.skip(scanSpace(r.cur(), r.avail()));
+			continue;
+		}
+
+		if (ch == '/' && r.peek2() == '*') {
+			if (!skipBlockComment(r, err)) {
+				return false;
+			}
+			continue;
+		}
+
+		break;
+	}
+
+	return true;
+}
+
+static inline bool skipSep(Reader &r, bool &foundSep, String *err)
+{
+	if (!skipSpace(r, err)) {
+		return false;
+	}
+
+	int ch = r.peek();
+
+	if (ch == ',') {
+		r.get();
+		foundSep = true;
+		return skipWhitespace(r, err);
+	}
+
+	if (ch == '\n') {
+		r.get();
+		foundSep = true;
+		return skipWhitespace(r, err);
+	}
+
+	if (ch == '\r' && r.peek2() == '\n') {
+		r.get();
+		r.get();
+		foundSep = true;
+		return skipWhitespace(r, err);
+	}
+
+	if (ch == '/' && r.peek2() == '/') {
+		skipLineComment(r);
+		foundSep = true;
+		return true;
+	}
+
+	foundSep = false;
+	return true;
+}
+
+static inline bool parseHex(Reader &r, int n, uint32_t &ret, String *err)
+{
+	uint32_t num = 0;
+	while (n > 0) {
+		auto loc = r.loc();
+		int ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		num *= 16;
+		if (ch >= '0' && ch <= '9') {
+			num += ch - '0';
+		} else if (ch >= 'a' && ch <= 'f') {
+			num += ch - 'a' + 10;
+		} else if (ch >= 'A' && ch <= 'F') {
+			num += ch - 'A' + 10;
+		} else {
+			error(loc, err, "Invalid hex character");
+			return false;
+		}
+
+		n -= 1;
+	}
+
+	ret = num;
+	return true;
+}
+
+static inline bool parseIdentifier(Reader &r, String &ident, String *err)
+{
+	int ch = r.peek();
+	if (ch == EOF) {
+		error(r.loc(), err, "Unexpected EOF");
+		return false;
+	}
+
+	auto isFirstIdent = [](char ch) {
+		return
+			(ch >= 'a' && ch <= 'z') ||
+			(ch >= 'A' && ch <= 'Z') ||
+			ch == '_';
+	};
+	if (!isFirstIdent(ch)) {
+		error(r.loc(), err, "Unexpected character for identifier");
+		return false;
+	}
+
+	auto isIdent = [](char ch) {
+		return
+			(ch >= 'a' && ch <= 'z') ||
+			(ch >= 'A' && ch <= 'Z') ||
+			(ch >= '0' && ch <= '9') ||
+			ch == '_' || ch == '-';
+	};
+
+	ident = "";
+
+	do {
+		ident += r.get();
+	} while (isIdent(r.peek()));
+	return true;
+}
+
+template<typename T>
+static bool parseStringEscapeChar(char ch, T &str) {
+	if (ch == '"') {
+		str.push_back('"');
+		return true;
+	} else if (ch == '\\') {
+		str.push_back('\\');
+		return true;
+	} else if (ch == '/') {
+		str.push_back('/');
+		return true;
+	} else if (ch == 'b') {
+		str.push_back('\b');
+		return true;
+	} else if (ch == 'f') {
+		str.push_back('\f');
+		return true;
+	} else if (ch == 'n') {
+		str.push_back('\n');
+		return true;
+	} else if (ch == 'r') {
+		str.push_back('\r');
+		return true;
+	} else if (ch == 't') {
+		str.push_back('\t');
+		return true;
+	}
+
+	return false;
+}
+
+static inline void writeUTF8(uint32_t num, String &str)
+{
+	if (num >= 0x10000u) {
+		str += 0xf0u | ((num & 0x1c0000u) >> 18u);
+		str += 0x80u | ((num & 0x03f000u) >> 12u);
+		str += 0x80u | ((num & 0x000fc0u) >> 6u);
+		str += 0x80u | ((num & 0x00003fu) >> 0u);
+	} else if (num >= 0x0800u) {
+		str += 0xe0u | ((num & 0x00f000u) >> 12u);
+		str += 0x80u | ((num & 0x000fc0u) >> 6u);
+		str += 0x80u | ((num & 0x00003fu) >> 0u);
+	} else if (num >= 0x0080u) {
+		str += 0xc0u | ((num & 0x0007c0u) >> 6);
+		str += 0x80u | ((num & 0x00003fu) >> 0);
+	} else {
+		str += num;
+	}
+}
+
+static inline bool parseStringEscape(Reader &r, String &str, String *err)
+{
+	int ch = r.get();
+	if (ch == EOF) {
+		error(r.loc(), err, "Unexpected EOF");
+		return false;
+	}
+
+	if (parseStringEscapeChar(ch, str)) {
+		return true;
+	}
+
+	if (ch == 'x') {
+		unsigned int num;
+		if (!parseHex(r, 2, num, err)) {
+			return false;
+		}
+
+		str += (char)num;
+		return true;
+	}
+
+	if (ch == 'u') {
+		uint32_t codepoint;
+		auto loc = r.loc();
+		if (!parseHex(r, 4, codepoint, err)) {
+			return false;
+		}
+
+		if (codepoint >= 0xd800 && codepoint <= 0xdbff) {
+			if (r.peek() != '\\' || r.peek2() != 'u') {
+				error(loc, err, "Unpaired UTF-16 surrogate pair");
+				return false;
+			}
+
+			r.get();
+			r.get();
+			loc = r.loc();
+			uint32_t low;
+			if (!parseHex(r, 4, low, err)) {
+				return false;
+			}
+
+			if (low < 0xdc00 || low > 0xdfff) {
+				error(loc, err, "Unpaired UTF-16 surrogate pair");
+				return false;
+			}
+
+			codepoint = (codepoint - 0xd800) * 0x400;
+			codepoint += low - 0xDC00;
+			codepoint += 0x10000;
+		} else if (codepoint >= 0xdc00 && codepoint <= 0xdfff) {
+			error(loc, err, "Unexpected low UTF-16 surrogate pair");
+			return false;
+		}
+
+		writeUTF8(codepoint, str);
+		return true;
+	}
+
+	if (ch == 'U') {
+		uint32_t codepoint;
+		auto loc = r.loc();
+		if (!parseHex(r, 6, codepoint, err)) {
+			return false;
+		}
+
+		if (codepoint >= 0xd800 && codepoint <= 0xdfff) {
+			error(loc, err, "UTF-16 surrogate pair escapes are not allowed");
+			return false;
+		}
+
+		writeUTF8(codepoint, str);
+		return true;
+	}
+
+	error(r.loc(), err, "Unknown escape character");
+	return false;
+}
+
+static inline bool parseString(Reader &r, String &str, String *err)
+{
+	str.clear();
+	r.get(); // '"'
+
+	while (true) {
+		// Copy everything up to the next special character in one go
+		size_t idx = findStringSpecial(r.cur(), r.avail());
+		str.append((const char *)r.cur(), idx);
+		r.skip(idx);
+
+		int ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (ch == '"') {
+			return true;
+		}
+
+		if (ch == '\\') {
+			if (!parseStringEscape(r, str, err)) {
+				return false;
+			}
+
+			continue;
+		}
+
+		if (ch < 0x20) {
+			error(r.loc(), err, "Unexpected control character");
+			return false;
+		}
+
+		str += ch;
+	}
+}
+
+// Parse a quoted string which can be used straight from the input,
+// because it has no escapes or control characters.
+// Returns false, without consuming anything, if it can't.
+static inline bool parsePlainString(Reader &r, std::string_view &str)
+{
+	const unsigned char *start = r.cur() + 1; // After the '"'
+	size_t n = r.avail() - 1;
+	size_t idx = findStringSpecial(start, n);
+	if (idx == n || start[idx] != '"') {
+		return false;
+	}
+
+	str = std::string_view((const char *)start, idx);
+	r.skip(idx + 2);
+	return true;
+}
+
+static inline bool charValue(int ch, int &num)
+{
+	if (ch >= '0' && ch <= '9') {
+		num = ch - '0';
+		return true;
+	} else if (ch >= 'a' && ch <= 'f') {
+		num = ch - 'a' + 10;
+		return true;
+	} else if (ch >= 'A' && ch <= 'F') {
+		num = ch - 'A' + 10;
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool parseBinaryString(Reader &r, BString &bytes, String *err)
+{
+	bytes.clear();
+	r.get(); // 'b'
+	r.get(); // '"'
+
+	while (true) {
+		// Copy printable characters in one go
+		size_t idx = findBinarySpecial(r.cur(), r.avail(), 0x7f);
+		bytes.insert(bytes.end(), r.cur(), r.cur() + idx);
+		r.skip(idx);
+
+		// Decode runs of hex escapes straight from the buffer;
+		// anything unusual is left for the code below
+		size_t i = decodeHexEscapes(
+			std::string_view((const char *)r.cur(), r.avail()), bytes);
+		if (i > 0) {
+			r.skip(i);
+			continue;
+		}
+
+		auto loc = r.loc();
+		int ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (ch == '"') {
+			return true;
+		}
+
+		if (ch == '\\') {
+			ch = r.get();
+			if (ch == EOF) {
+				error(r.loc(), err, "Unexpected EOF");
+				return false;
+			}
+
+			if (ch == 'x') {
+				uint32_t num;
+				if (!parseHex(r, 2, num, err)) {
+					return false;
+				}
+				bytes.push_back(num);
+				continue;
+			}
+
+			if (!parseStringEscapeChar(ch, bytes)) {
+				error(r.loc(), err, "Unknown escape character");
+				return false;
+			}
+
+			continue;
+		}
+
+		if (ch > 127) {
+			error(loc, err, "Binary strings can only contain ASCII");
+			return false;
+		} else if (ch < 0x20) {
+			error(loc, err, "Unexpected control character");
+			return false;
+		}
+
+		bytes.push_back(ch);
+	}
+}
+
+static inline bool parseMultiLineString(Reader &r, String &str, String *err)
+{
+	str.clear();
+	r.get(); // '|'
+
+	while (true) {
+		while (true) {
+			size_t idx = findLineEnd(r.cur(), r.avail());
+			str.append((const char *)r.cur(), idx);
+			r.skip(idx);
+
+			int ch = r.get();
+			if (ch == EOF || ch == '\n' || (ch == '\r' && r.peek2() == '\n')) {
+				break;
+			}
+
+			str += ch;
+		}
+
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+
+		if (r.peek() == '|') {
+			r.get();
+			str += '\n';
+		} else {
+			return true;
+		}
+	}
+}
+
+// If view isn't null, the string is returned as a view into the input
+// instead of being copied into str, which needs the input to be in memory
+static inline bool parseRawString(
+	Reader &r, String &str, String *err,
+	std::string_view *view = nullptr)
+{
+	str.clear();
+	r.get(); // 'r'
+
+	int hashes = 0;
+	int ch;
+	while ((ch = r.get()) == '#') {
+		hashes += 1;
+	}
+	if (ch != '"') {
+		error(r.loc(), err, "Expected '\"'");
+		return false;
+	}
+
+	const unsigned char *start = r.cur();
+	while (true) {
+		// Everything up to the next '"' is part of the string
+		size_t n = r.avail();
+		auto *quote = (const unsigned char *)memchr(r.cur(), '"', n);
+		size_t idx = quote ? quote - r.cur() : n;
+		if (!view) {
+			str.append((const char *)r.cur(), idx);
+		}
+		r.advance(idx);
+
+		ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (ch != '"') {
+			if (!view) {
+				str += ch;
+			}
+			continue;
+		}
+
+		int found = 0;
+		while (found < hashes && r.peek() == '#') {
+			r.get();
+			found += 1;
+		}
+
+		if (found == hashes) {
+			if (view) {
+				*view = std::string_view(
+					(const char *)start, r.cur() - start - 1 - hashes);
+			}
+			return true;
+		}
+
+		if (!view) {
+			str += '"';
+			str.append(found, '#');
+		}
+	}
+}
+
+// Read digits in the given radix, which may be separated by '\''.
+// The first character must be a digit.
+template<typename F>
+static bool parseDigits(Reader &r, int radix, String *err, F onDigit)
+{
+	int digit;
+
+	auto loc = r.loc();
+	if (!charValue(r.peek(), digit)) {
+		error(loc, err, "Expected digit");
+		return false;
+	}
+
+	if (digit >= radix) {
+		error(loc, err, "Invalid digit");
+		return false;
+	}
+
+	while (true) {
+		const unsigned char *p = r.cur();
+		size_t n = r.avail();
+		size_t i = 0;
+		for (; i < n; ++i) {
+			if (p[i] == '\'') {
+				continue;
+			}
+
+			if (!charValue(p[i], digit) || digit >= radix) {
+				break;
+			}
+
+			onDigit(digit);
+		}
+
+		r.skip(i);
+		if (i < n || r.peek() == EOF) {
+			return true;
+		}
+	}
+}
+
+// The significant digits of a decimal number,
+// whose value is digits * 10^exponent
+struct Decimal {
+	// Digits past this many can't affect the correctly rounded result
+	static constexpr int maxDigits = 768;
+
+	uint64_t mantissa = 0; // The first 19 significant digits
+	int count = 0;
+	int64_t exponent = 0;
+	char digits[maxDigits];
+
+	// Whether a nonzero digit past maxDigits was dropped.
+	// It still decides which way a value exactly halfway
+	// between two doubles rounds.
+	bool truncated = false;
+
+	void add(int digit, bool fractional) {
+		// Leading zeros aren't significant,
+		// but fractional ones still move the decimal point
+		if (count == 0 && digit == 0) {
+			exponent -= fractional;
+			return;
+		}
+
+		if (count < 19) {
+			mantissa = mantissa * 10 + digit;
+		}
+
+		if (count < maxDigits) {
+			digits[count++] = '0' + digit;
+			exponent -= fractional;
+		} else {
+			exponent += !fractional;
+			truncated = truncated || digit != 0;
+		}
+	}
+
+	// Get the value as an integer, if it is one and it fits in 64 bits
+	bool integer(uint64_t &ret) {
+		if (exponent != 0 || count > 20) {
+			return false;
+		}
+
+		if (count <= 19) {
+			ret = mantissa;
+			return true;
+		}
+
+		uint64_t num = mantissa;
+		int digit = digits[19] - '0';
+		if (
+			__builtin_mul_overflow(num, 10, &num) ||
+			__builtin_add_overflow(num, digit, &num)) {
+			return false;
+		}
+
+		ret = num;
+		return true;
+	}
+
+	double value() {
+		static const double powersOf10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+		};
+
+		if (count == 0) {
+			return 0;
+		}
+
+		// Integers and short decimals are exact with one
+		// conversion and at most one correctly rounded operation
+		if (count <= 19 && exponent == 0) {
+			return double(mantissa);
+		} else if (
+			count <= 19 && mantissa <= (uint64_t(1) << 53) &&
+			exponent >= -22 && exponent <= 22) {
+			if (exponent < 0) {
+				return double(mantissa) / powersOf10[-exponent];
+			} else {
+				return double(mantissa) * powersOf10[exponent];
+			}
+		}
+
+		// Everything else goes through from_chars,
+		// which is exact and doesn't depend on the locale.
+		// Dropped digits are stood in for by a trailing 1,
+		// which is enough to push a halfway value the right way.
+		char buf[maxDigits + 32];
+		memcpy(buf, digits, count);
+		int len = count;
+		int64_t exp = exponent;
+		if (truncated) {
+			buf[len++] = '1';
+			exp -= 1;
+		}
+		buf[len] = 'e';
+		auto res = std::to_chars(buf + len + 1, buf + sizeof(buf), exp);
+
+		double num = 0;
+		auto parsed = std::from_chars(buf, res.ptr, num);
+		if (parsed.ec == std::errc::result_out_of_range) {
+			return exponent + count > 0 ? HUGE_VAL : 0.0;
+		}
+
+		return num;
+	}
+};
+
+// Report an integer literal with the given sign and magnitude,
+// as a double if it doesn't fit in an Int or UInt
+template<typename Builder>
+static bool reportInteger(Builder &b, bool negative, uint64_t magnitude)
+{
+	if (!negative && magnitude <= uint64_t(INT64_MAX)) {
+		return b.number(Int(magnitude));
+	} else if (!negative) {
+		return b.number(UInt(magnitude));
+	} else if (magnitude == 0) {
+		// Integers can't represent -0
+		return b.number(Number(-0.0));
+	} else if (magnitude - 1 <= uint64_t(INT64_MAX)) {
+		return b.number(Int(-Int(magnitude - 1) - 1));
+	} else {
+		return b.number(-Number(magnitude));
+	}
+}
+
+template<typename Builder>
+static bool parseNumber(Reader &r, Builder &b, String *err)
+{
+	bool negative = false;
+	int ch = r.peek();
+	if (ch == '-') {
+		negative = true;
+		r.get();
+		ch = r.peek();
+	} else if (ch == '+') {
+		r.get();
+		ch = r.peek();
+	}
+
+	int bits = 0;
+	if (ch == '0') {
+		int ch2 = r.peek2();
+		if (ch2 == 'x') {
+			bits = 4;
+		} else if (ch2 == 'o') {
+			bits = 3;
+		} else if (ch2 == 'b') {
+			bits = 1;
+		}
+	}
+
+	// Hex, octal and binary numbers are integers.
+	// The first 61 to 64 bits are kept, and any bits after that
+	// only matter for rounding, so they're folded into the lowest bit.
+	if (bits != 0) {
+		r.get();
+		r.get();
+
+		uint64_t mantissa = 0;
+		int shift = 0;
+		bool sticky = false;
+		bool ok = parseDigits(r, 1 << bits, err, [&](int digit) {
+			if ((mantissa >> (64 - bits)) == 0) {
+				mantissa = (mantissa << bits) | digit;
+			} else {
+				shift += bits;
+				sticky = sticky || digit != 0;
+			}
+		});
+		if (!ok) {
+			return false;
+		}
+
+		if (shift == 0) {
+			if (!reportInteger(b, negative, mantissa)) {
+				return stopped(r, err);
+			}
+			return true;
+		}
+
+		double num = ldexp(double(mantissa | sticky), shift);
+		if (!b.number(negative ? -num : num)) {
+			return stopped(r, err);
+		}
+		return true;
+	}
+
+	Decimal dec;
+	if (ch != '.') {
+		bool ok = parseDigits(r, 10, err, [&](int digit) {
+			dec.add(digit, false);
+		});
+		if (!ok) {
+			return false;
+		}
+		ch = r.peek();
+	}
+
+	uint64_t integer;
+	if (ch != '.' && ch != 'e' && ch != 'E' && dec.integer(integer)) {
+		if (!reportInteger(b, negative, integer)) {
+			return stopped(r, err);
+		}
+		return true;
+	}
+
+	if (ch == '.') {
+		r.get();
+
+		ch = r.peek();
+		if (!(ch >= '0' && ch <= '9')) {
+			error(r.loc(), err, "Expected digit");
+			return false;
+		}
+
+		parseDigits(r, 10, err, [&](int digit) {
+			dec.add(digit, true);
+		});
+		ch = r.peek();
+	}
+
+	if (ch == 'e' || ch == 'E') {
+		r.get();
+		ch = r.peek();
+		bool negativeExponent = false;
+		if (ch == '-') {
+			negativeExponent = true;
+			r.get();
+		} else if (ch == '+') {
+			r.get();
+		}
+
+		// Anything past a billion is infinity or zero anyway
+		int64_t exponent = 0;
+		bool ok = parseDigits(r, 10, err, [&](int digit) {
+			if (exponent < 1000000000) {
+				exponent = exponent * 10 + digit;
+			}
+		});
+		if (!ok) {
+			return false;
+		}
+
+		dec.exponent += negativeExponent ? -exponent : exponent;
+	}
+
+	double num = dec.value();
+	if (!b.number(negative ? -num : num)) {
+		return stopped(r, err);
+	}
+	return true;
+}
+
+// The skip functions below move past a value without decoding it.
+// They only look for where the value ends, so they don't validate
+// escapes, numbers or keywords.
+
+// Skip a quoted or binary string, starting at the '"'
+static inline bool skipQuotedString(Reader &r, String *err)
+{
+	r.get(); // '"'
+	while (true) {
+		r.skip(findStringSpecial(r.cur(), r.avail()));
+
+		int ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (ch == '"') {
+			return true;
+		}
+
+		if (ch == '\\' && r.get() == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+	}
+}
+
+static inline bool skipRawString(Reader &r, String *err)
+{
+	r.get(); // 'r'
+
+	int hashes = 0;
+	int ch;
+	while ((ch = r.get()) == '#') {
+		hashes += 1;
+	}
+	if (ch != '"') {
+		error(r.loc(), err, "Expected '\"'");
+		return false;
+	}
+
+	while (true) {
+		size_t n = r.avail();
+		auto *quote = (const unsigned char *)memchr(r.cur(), '"', n);
+		r.advance(quote ? quote - r.cur() : n);
+
+		ch = r.get();
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (ch != '"') {
+			continue;
+		}
+
+		int found = 0;
+		while (found < hashes && r.peek() == '#') {
+			r.get();
+			found += 1;
+		}
+
+		if (found == hashes) {
+			return true;
+		}
+	}
+}
+
+static inline bool skipMultiLineString(Reader &r, String *err)
+{
+	while (r.peek() == '|') {
+		while (true) {
+			r.skip(findLineEnd(r.cur(), r.avail()));
+
+			int ch = r.get();
+			if (ch == EOF || ch == '\n' || (ch == '\r' && r.peek2() == '\n')) {
+				break;
+			}
+		}
+
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Skip a number or keyword
+static inline bool skipBareword(Reader &r, String *err)
+{
+	auto isBareword = [](int ch) {
+		return
+			(ch >= 'a' && ch <= 'z') ||
+			(ch >= 'A' && ch <= 'Z') ||
+			(ch >= '0' && ch <= '9') ||
+			ch == '_' || ch == '-' || ch == '+' || ch == '.' || ch == '\'';
+	};
+
+	if (!isBareword(r.peek())) {
+		error(r.loc(), err, "Unexpected character");
+		return false;
+	}
+
+	while (true) {
+		const unsigned char *p = r.cur();
+		size_t n = r.avail();
+		size_t i = 0;
+		while (i < n && isBareword(p[i])) {
+			i += 1;
+		}
+
+		r.skip(i);
+		if (i < n || r.peek() == EOF) {
+			return true;
+		}
+	}
+}
+
+// Skip to the end of an array or object whose opening bracket
+// has already been read, by counting brackets.
+// Strings and comments are skipped, since they may contain brackets.
+static inline bool skipNested(Reader &r, String *err)
+{
+	// The characters which can start or end something
+	static const auto special = [] {
+		std::array<bool, 256> table{};
+		for (unsigned char ch: std::string_view("[]{}\"|/r")) {
+			table[ch] = true;
+		}
+		return table;
+	}();
+
+	auto isWordChar = [](int ch) {
+		return
+			(ch >= 'a' && ch <= 'z') ||
+			(ch >= 'A' && ch <= 'Z') ||
+			(ch >= '0' && ch <= '9') ||
+			ch == '_' || ch == '-';
+	};
+
+	int depth = 1;
+
+	// Whether the previous character was part of a bare word,
+	// so that an 'r' in the middle of one doesn't start a raw string
+	bool inWord = false;
+
+	while (true) {
+		const unsigned char *p = r.cur();
+		size_t n = r.avail();
+		size_t i = 0;
+		while (i < n && !special[p[i]]) {
+			i += 1;
+		}
+
+		if (i > 0) {
+			inWord = isWordChar(p[i - 1]);
+			r.advance(i);
+		}
+
+		int ch = r.peek();
+		bool ok = true;
+		switch (ch) {
+		case EOF:
+			r.get();
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+
+		case '[': case '{':
+			r.get();
+			depth += 1;
+			break;
+
+		case ']': case '}':
+			r.get();
+			depth -= 1;
+			if (depth == 0) {
+				return true;
+			}
+			break;
+
+		case '"':
+			ok = skipQuotedString(r, err);
+			break;
+
+		case '|':
+			ok = skipMultiLineString(r, err);
+			break;
+
+		case '/':
+			if (r.peek2() == '/') {
+				skipLineComment(r);
+			} else if (r.peek2() == '*') {
+				ok = skipBlockComment(r, err);
+			} else {
+				r.get();
+			}
+			break;
+
+		case 'r':
+			if (!inWord && (r.peek2() == '"' || r.peek2() == '#')) {
+				ok = skipRawString(r, err);
+				break;
+			}
+			r.get();
+			inWord = true;
+			continue;
+
+		default:
+			// Only reached at the end of the buffer
+			continue;
+		}
+
+		if (!ok) {
+			return false;
+		}
+		inWord = false;
+	}
+}
+
+// Skip any value
+static inline bool skipValue(Reader &r, String *err)
+{
+	int ch = r.peek();
+	if (ch == EOF) {
+		error(r.loc(), err, "Unexpected EOF");
+		return false;
+	} else if (ch == '[' || ch == '{') {
+		r.get();
+		return skipNested(r, err);
+	} else if (ch == '"') {
+		return skipQuotedString(r, err);
+	} else if (ch == 'b' && r.peek2() == '"') {
+		r.get();
+		return skipQuotedString(r, err);
+	} else if (ch == 'r' && (r.peek2() == '"' || r.peek2() == '#')) {
+		return skipRawString(r, err);
+	} else if (ch == '|') {
+		return skipMultiLineString(r, err);
+	} else {
+		return skipBareword(r, err);
+	}
+}
+
+static inline bool parseKey(Reader &r, String &key, String *err)
+{
+	if (r.peek() == '"') {
+		return parseString(r, key, err);
+	} else {
+		return parseIdentifier(r, key, err);
+	}
+}
+
+// Parse the rest of a list of key-value pairs,
+// where the first key has already been read into the builder's buffer
+template<typename Builder>
+static bool parseKeyValuePairsAfterKey(
+	Reader &r, Builder &b, int depth, String *err)
+{
+	while (true) {
+		if (r.peek() != ':') {
+			error(r.loc(), err, "Expected ':'");
+			return false;
+		}
+		r.get();
+		if (!b.key()) {
+			return stopped(r, err);
+		}
+
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+
+		// If the next value is a multi-line string,
+		// always assume that we have had a separator
+		bool hasSep = r.peek() == '|';
+
+		if (!parseValue(r, b, depth, err)) {
+			return false;
+		}
+
+		bool realHasSep;
+		if (!skipSep(r, realHasSep, err)) {
+			return false;
+		}
+		hasSep = hasSep || realHasSep;
+
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+
+		int ch = r.peek();
+		if (ch == '}' || ch == EOF) {
+			return true;
+		}
+
+		if (!hasSep) {
+			error(r.loc(), err, "Expected separator, '}' or EOF");
+			return false;
+		}
+
+		if (!parseKey(r, b.buffer(), err)) {
+			return false;
+		}
+
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+	}
+}
+
+template<typename Builder>
+static bool parseKeyValuePairs(Reader &r, Builder &b, int depth, String *err)
+{
+	if (!parseKey(r, b.buffer(), err)) {
+		return false;
+	}
+
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	return parseKeyValuePairsAfterKey(r, b, depth, err);
+}
+
+template<typename Builder>
+static bool parseObject(Reader &r, Builder &b, int depth, String *err)
+{
+	if (r.peek() != '{') {
+		error(r.loc(), err, "Expected '{'");
+		return false;
+	}
+	r.get();
+	if (!b.beginObject()) {
+		return stopped(r, err);
+	}
+
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	if (r.peek() == '}') {
+		r.get();
+		if (!b.endObject()) {
+			return stopped(r, err);
+		}
+		return true;
+	}
+
+	if (!parseKeyValuePairs(r, b, depth, err)) {
+		return false;
+	}
+
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	if (r.peek() != '}') {
+		error(r.loc(), err, "Expected '{'");
+		return false;
+	}
+	r.get();
+	if (!b.endObject()) {
+		return stopped(r, err);
+	}
+	return true;
+}
+
+template<typename Builder>
+static bool parseArray(Reader &r, Builder &b, int depth, String *err)
+{
+	if (r.peek() != '[') {
+		error(r.loc(), err, "Expected '['");
+		return false;
+	}
+	r.get();
+	if (!b.beginArray()) {
+		return stopped(r, err);
+	}
+
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	if (r.peek() == ']') {
+		r.get();
+		if (!b.endArray()) {
+			return stopped(r, err);
+		}
+		return true;
+	}
+
+	while (true) {
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+
+		// If the next value is a multi-line string,
+		// always assume that we have had a separator
+		bool hasSep = r.peek() == '|';
+
+		if (!parseValue(r, b, depth, err)) {
+			return false;
+		}
+
+		bool realHasSep;
+		if (!skipSep(r, realHasSep, err)) {
+			return false;
+		}
+		hasSep = hasSep | realHasSep;
+
+		int ch = r.peek();
+		if (ch == ']') {
+			r.get();
+			if (!b.endArray()) {
+				return stopped(r, err);
+			}
+			return true;
+		}
+
+		if (ch == EOF) {
+			error(r.loc(), err, "Unexpected EOF");
+			return false;
+		}
+
+		if (!hasSep) {
+			error(r.loc(), err, "Expected separator or ']'");
+			return false;
+		}
+	}
+}
+
+// A key at the top level means that the document is an object without braces
+template<typename Builder>
+static bool parseTopLevelKey(Reader &r, Builder &b, int depth, String *err)
+{
+	if (!b.beginObject()) {
+		return stopped(r, err);
+	}
+
+	if (!parseKeyValuePairsAfterKey(r, b, depth, err)) {
+		return false;
+	}
+
+	if (!b.endObject()) {
+		return stopped(r, err);
+	}
+	return true;
+}
+
+template<typename Builder>
+static bool parseValue(
+	Reader &r, Builder &b, int depth,
+	String *err, bool topLevel)
+{
+	if (depth <= 0) {
+		error(r.loc(), err, "Nesting limit exceeded");
+		return false;
+	}
+
+	int ch = r.peek();
+	if (ch == EOF) {
+		error(r.loc(), err, "Unexpected EOF");
+		return false;
+	}
+
+	if constexpr (CanDefer<Builder>::value) {
+		if (!topLevel && b.defer(r, depth)) {
+			if (!skipValue(r, err)) {
+				return false;
+			}
+			b.deferred(r);
+			return true;
+		}
+	}
+
+	if (ch == '[') {
+		return parseArray(r, b, depth - 1, err);
+	} else if (ch == '{') {
+		return parseObject(r, b, depth - 1, err);
+	} else if (ch == '"') {
+		// Top-level strings might turn out to be keys
+		if constexpr (CanView<Builder>::value) {
+			std::string_view str;
+			if (!topLevel && r.inMemory() && parsePlainString(r, str)) {
+				if (!b.stringView(str, true)) {
+					return stopped(r, err);
+				}
+				return true;
+			}
+		}
+
+		if (!parseString(r, b.buffer(), err)) {
+			return false;
+		}
+
+		if (topLevel) {
+			if (!skipWhitespace(r, err)) {
+				return false;
+			}
+
+			if (r.peek() == ':') {
+				return parseTopLevelKey(r, b, depth - 1, err);
+			}
+		}
+
+		if (!b.string()) {
+			return stopped(r, err);
+		}
+		return true;
+	} else if (ch == 'r' && (r.peek2() == '"' || r.peek2() == '#')) {
+		if constexpr (CanView<Builder>::value) {
+			if (r.inMemory()) {
+				std::string_view str;
+				if (!parseRawString(r, b.buffer(), err, &str)) {
+					return false;
+				}
+
+				if (!b.stringView(str, false)) {
+					return stopped(r, err);
+				}
+				return true;
+			}
+		}
+
+		if (!parseRawString(r, b.buffer(), err)) {
+			return false;
+		}
+
+		if (!b.string()) {
+			return stopped(r, err);
+		}
+		return true;
+	} else if ((ch >= '0' && ch <= '9') || ch == '.' || ch == '+' || ch == '-') {
+		return parseNumber(r, b, err);
+	} else if (ch == 'b' && r.peek2() == '"') {
+		BString bytes;
+		if (!parseBinaryString(r, bytes, err)) {
+			return false;
+		}
+
+		if (!b.bstring(bytes)) {
+			return stopped(r, err);
+		}
+		return true;
+	} else if (ch == '|') {
+		if (!parseMultiLineString(r, b.buffer(), err)) {
+			return false;
+		}
+
+		if (!b.string()) {
+			return stopped(r, err);
+		}
+		return true;
+	}
+
+	auto loc = r.loc();
+	String &ident = b.buffer();
+	if (!parseIdentifier(r, ident, err)) {
+		return false;
+	}
+
+	if (topLevel) {
+		if (!skipWhitespace(r, err)) {
+			return false;
+		}
+
+		if (r.peek() == ':') {
+			return parseTopLevelKey(r, b, depth - 1, err);
+		}
+	}
+
+	bool ok;
+	if (ident == "null") {
+		ok = b.null();
+	} else if (ident == "true") {
+		ok = b.boolean(true);
+	} else if (ident == "false") {
+		ok = b.boolean(false);
+	} else if (ident.size() > 0) {
+		error(loc, err, "Unexpected keyword");
+		return false;
+	} else {
+		error(loc, err, "Unexpected character");
+		return false;
+	}
+
+	if (!ok) {
+		return stopped(r, err);
+	}
+	return true;
+}
+
+// Parse a whole document, which must be followed by nothing but whitespace
+template<typename Builder>
+static bool parseDocument(Reader &r, Builder &b, String *err, int maxDepth)
+{
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	if (!parseValue(r, b, maxDepth, err, true)) {
+		return false;
+	}
+
+	if (!skipWhitespace(r, err)) {
+		return false;
+	}
+
+	if (r.peek() != EOF) {
+		error(r.loc(), err, "Trailing garbage after document");
+		return false;
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,154 @@
+#include "push.h"
+#include "parser.h"
+
+namespace Mason {
+
+PushParser::PushParser(Handler &h, int maxDepth):
+	h_(h), cursor_(std::string_view(""), maxDepth) {}
+
+bool PushParser::feed(const char *data, size_t size)
+{
+	if (failed_ || done_) {
+		return false;
+	}
+
+	Reader &r = *cursor_.reader_;
+
+	// When nothing is left over from the previous piece,
+	// parse straight from the caller's buffer and only keep what's left
+	bool direct = pending_.empty();
+	if (!direct) {
+		pending_.append(data, size);
+		data = pending_.data();
+		size = pending_.size();
+	}
+
+	r.rebase(data, size, base_);
+	if (size < retryAt_) {
+		return true;
+	}
+
+	bool ok = run(false);
+
+	size_t used = r.pos().offset - base_;
+	base_ += used;
+	if (direct) {
+		pending_.assign(data + used, size - used);
+	} else {
+		pending_.erase(0, used);
+	}
+	r.rebase(pending_.data(), pending_.size(), base_);
+	return ok;
+}
+
+bool PushParser::finish()
+{
+	if (failed_ || done_) {
+		return done_;
+	}
+
+	if (!run(true)) {
+		return false;
+	}
+
+	pending_.clear();
+	done_ = true;
+	return true;
+}
+
+// Parse as many tokens as possible.
+// Unless this is the final piece of input, a token which runs into
+// the end of the input is undone, to be parsed again once more has arrived.
+bool PushParser::run(bool final)
+{
+	using Token = Cursor::Token;
+	Cursor &c = cursor_;
+	Reader &r = *c.reader_;
+
+	while (c.token_ != Token::End) {
+		// Everything a single token can change
+		auto pos = r.pos();
+		Token token = c.token_;
+		bool consumed = c.consumed_;
+		bool done = c.done_;
+		bool rootDone = c.rootDone_;
+		size_t depth = c.frames_.size();
+		Cursor::Frame top = depth > 0 ? c.frames_.back() : Cursor::Frame{};
+
+		r.resetHitEnd();
+		Token tok = c.next();
+
+		std::string_view str;
+		BString bytes;
+		if (tok == Token::Key) {
+			// Like parse(), only report a key once its ':' has been seen
+			if (c.readKey(str) && c.finishKey()) {
+				c.done_ = true;
+			} else {
+				c.fail();
+			}
+		} else if (tok == Token::String) {
+			c.readString(str);
+		} else if (tok == Token::BString) {
+			c.readBString(bytes);
+		} else if (tok == Token::Number) {
+			c.readNumberToken();
+		}
+
+		if (!final && r.hitEnd()) {
+			c.token_ = token;
+			c.consumed_ = consumed;
+			c.done_ = done;
+			c.rootDone_ = rootDone;
+			c.frames_.resize(depth, top);
+			if (depth > 0) {
+				c.frames_.back() = top;
+			}
+			c.err_.clear();
+			r.seek(pos);
+
+			retryAt_ = r.avail() * 2;
+			return true;
+		}
+
+		if (c.token_ == Token::Error) {
+			failed_ = true;
+			return false;
+		}
+
+		bool ok = true;
+		switch (tok) {
+		case Token::Null: ok = h_.onNull(); break;
+		case Token::Bool: ok = h_.onBool(c.bool_); break;
+		case Token::Number:
+			if (c.numType_ == Type::Int) {
+				ok = h_.onInt(c.int_);
+			} else if (c.numType_ == Type::UInt) {
+				ok = h_.onUInt(c.uint_);
+			} else {
+				ok = h_.onNumber(c.number_);
+			}
+			break;
+		case Token::String: ok = h_.onString(str); break;
+		case Token::BString: ok = h_.onBString(bytes.data(), bytes.size()); break;
+		case Token::BeginArray: ok = h_.onBeginArray(); break;
+		case Token::EndArray: ok = h_.onEndArray(); break;
+		case Token::BeginObject: ok = h_.onBeginObject(); break;
+		case Token::Key: ok = h_.onKey(str); break;
+		case Token::EndObject: ok = h_.onEndObject(); break;
+		default: break;
+		}
+
+		if (!ok) {
+			stopped(r, &c.err_);
+			c.fail();
+			failed_ = true;
+			return false;
+		}
+	}
+
+	retryAt_ = 0;
+	return true;
+}
+
+}
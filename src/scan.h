@@ -0,0 +1,298 @@
+#pragma once
+
+// Scanning helpers which look at many bytes at once.
+// Which instruction set is used is decided at compile time;
+// build with -mavx2 (or -march=native) to get the 32-byte versions.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Mason {
+
+static inline bool isWhitespace(unsigned char ch)
+{
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+static inline bool isSpace(unsigned char ch)
+{
+	return ch == ' ' || ch == '\t';
+}
+
+// Return the number of leading ' ', '\t', '\r' and '\n' bytes
+static inline size_t scanWhitespace(const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+		uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+		uint32_t mask = ~(uint32_t)_mm_movemask_epi8(m) & 0xffffu;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (!isWhitespace(p[i])) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+// Return the number of leading ' ' and '\t' bytes
+static inline size_t scanSpace(const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i m = _mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+		uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i m = _mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+		uint32_t mask = ~(uint32_t)_mm_movemask_epi8(m) & 0xffffu;
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (!isSpace(p[i])) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+// Return the index of the first "*/", or n if there is none
+static inline size_t findBlockCommentEnd(const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 33 <= n; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+		__m256i m = _mm256_and_si256(
+			_mm256_cmpeq_epi8(a, _mm256_set1_epi8('*')),
+			_mm256_cmpeq_epi8(b, _mm256_set1_epi8('/')));
+		uint32_t mask = _mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 17 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+		__m128i m = _mm_and_si128(
+			_mm_cmpeq_epi8(a, _mm_set1_epi8('*')),
+			_mm_cmpeq_epi8(b, _mm_set1_epi8('/')));
+		uint32_t mask = _mm_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i + 1 < n; ++i) {
+		if (p[i] == '*' && p[i + 1] == '/') {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+// Return the index of the first '"', '\\' or control character,
+// or n if there is none
+static inline size_t findStringSpecial(const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+			_mm256_cmpeq_epi8(
+				_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)), v));
+		uint32_t mask = _mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+			_mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v));
+		uint32_t mask = _mm_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (p[i] == '"' || p[i] == '\\' || p[i] < 0x20) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+// Return the index of the first byte in a binary string which isn't
+// printable ASCII up to maxPlain (0x7e or 0x7f), or is a '"' or '\\',
+// or n if there is none
+static inline size_t findBinarySpecial(
+	const unsigned char *p, size_t n, unsigned char maxPlain)
+{
+	size_t i = 0;
+
+	// Bytes from 0x80 are negative as signed bytes,
+	// so a signed comparison with 0x20 catches them too
+
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i m = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))),
+			_mm256_or_si256(
+				_mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), v),
+				_mm256_cmpgt_epi8(v, _mm256_set1_epi8(maxPlain))));
+		uint32_t mask = _mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i m = _mm_or_si128(
+			_mm_or_si128(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))),
+			_mm_or_si128(
+				_mm_cmplt_epi8(v, _mm_set1_epi8(0x20)),
+				_mm_cmpgt_epi8(v, _mm_set1_epi8(maxPlain))));
+		uint32_t mask = _mm_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (p[i] == '"' || p[i] == '\\' || p[i] < 0x20 || p[i] > maxPlain) {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+// Return the index of the first '\n' or '\r', or n if there is none
+static inline size_t findLineEnd(const unsigned char *p, size_t n)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= n; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+		__m256i m = _mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+		uint32_t mask = _mm256_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+#if defined(__SSE2__)
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		__m128i m = _mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+		uint32_t mask = _mm_movemask_epi8(m);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; i < n; ++i) {
+		if (p[i] == '\n' || p[i] == '\r') {
+			return i;
+		}
+	}
+
+	return n;
+}
+
+}
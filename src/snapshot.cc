@@ -0,0 +1,127 @@
+#include "snapshot.h"
+#include "writer.h"
+
+#include <cstring>
+
+namespace Mason {
+
+// The version is written in the machine's byte order,
+// so it also tells whether the byte order matches
+struct SnapshotHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t words;
+	uint64_t strings;
+};
+
+static const char snapshotMagic[4] = {'M', 'S', 'N', 'P'};
+static constexpr uint32_t snapshotVersion = 1;
+
+bool Snapshot::open(const char *path, String *err)
+{
+	close();
+	if (!file_.open(path, err)) {
+		return false;
+	}
+
+	if (!load(err)) {
+		if (err) {
+			*err = path + (": " + *err);
+		}
+		return false;
+	}
+
+	return true;
+}
+
+bool Snapshot::open(int fd, String *err)
+{
+	close();
+	return file_.open(fd, err) && load(err);
+}
+
+void Snapshot::close()
+{
+	file_.close();
+	words_ = nullptr;
+	strings_ = nullptr;
+}
+
+bool Snapshot::load(String *err)
+{
+	auto fail = [&](const char *what) {
+		if (err) {
+			*err = what;
+		}
+		close();
+		return false;
+	};
+
+	SnapshotHeader header;
+	if (file_.size() < sizeof(header)) {
+		return fail("Not a snapshot");
+	}
+
+	memcpy(&header, file_.data(), sizeof(header));
+	if (memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+		return fail("Not a snapshot");
+	} else if (header.version != snapshotVersion) {
+		return fail("Unsupported snapshot version or byte order");
+	}
+
+	size_t body = file_.size() - sizeof(header);
+	if (header.words == 0 ||
+			header.words > body / sizeof(uint64_t) ||
+			header.strings != body - header.words * sizeof(uint64_t)) {
+		return fail("Truncated snapshot");
+	}
+
+	// Memory mapped files are page aligned,
+	// and files which were read are in a heap allocation
+	if ((uintptr_t)file_.data() % alignof(uint64_t) != 0) {
+		return fail("Misaligned snapshot");
+	}
+
+	words_ = (const uint64_t *)(file_.data() + sizeof(header));
+	strings_ = (const char *)(words_ + header.words);
+
+	// A cheap check that the root value takes up exactly the whole tape
+	if (root().next() != header.words) {
+		return fail("Corrupt snapshot");
+	}
+
+	return true;
+}
+
+TapeRef Snapshot::root() const
+{
+	if (!words_) {
+		return {};
+	}
+
+	return {words_, strings_, 0};
+}
+
+void writeSnapshot(Writer &w, const Tape &tape)
+{
+	SnapshotHeader header;
+	memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+	header.version = snapshotVersion;
+	header.words = tape.words().size();
+	header.strings = tape.strings().size();
+
+	w.write((const char *)&header, sizeof(header));
+	w.write(
+		(const char *)tape.words().data(),
+		tape.words().size() * sizeof(uint64_t));
+	w.write(tape.strings());
+}
+
+void writeSnapshot(Writer &w, const Value &v)
+{
+	Tape tape;
+	buildTape(v, tape);
+	writeSnapshot(w, tape);
+}
+
+}
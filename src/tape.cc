@@ -0,0 +1,333 @@
+#include "tape.h"
+#include "parser.h"
+
+namespace Mason {
+
+static uint64_t tapeWord(char tag, uint64_t payload)
+{
+	return (uint64_t((unsigned char)tag) << 56) | payload;
+}
+
+Type TapeRef::type() const
+{
+	switch (tag()) {
+	case 't': case 'f': return Type::Bool;
+	case 'd': return Type::Number;
+	case 'l': return Type::Int;
+	case 'u': return Type::UInt;
+	case '"': return Type::String;
+	case 'b': return Type::BString;
+	case '[': return Type::Array;
+	case '{': return Type::Object;
+	default: return Type::Null;
+	}
+}
+
+Number TapeRef::number() const
+{
+	if (isInt()) {
+		return Number(Int(word(1)));
+	} else if (isUInt()) {
+		return Number(word(1));
+	} else if (!isNumber()) {
+		return 0;
+	}
+
+	uint64_t bits = word(1);
+	Number num;
+	memcpy(&num, &bits, sizeof(num));
+	return num;
+}
+
+std::string_view TapeRef::string() const
+{
+	if (!isString()) {
+		return {};
+	}
+
+	return {strings_ + payload(), size_t(word(1))};
+}
+
+const unsigned char *TapeRef::bytes() const
+{
+	if (!isBString()) {
+		return nullptr;
+	}
+
+	return (const unsigned char *)strings_ + payload();
+}
+
+size_t TapeRef::size() const
+{
+	switch (tag()) {
+	case '"': case 'b': case '[': case '{':
+		return word(1);
+	default:
+		return 0;
+	}
+}
+
+size_t TapeRef::next() const
+{
+	switch (tag()) {
+	case 'd': case 'l': case 'u': case '"': case 'b':
+		return index_ + 2;
+	case '[': case '{':
+		return payload() + 1;
+	default:
+		return index_ + 1;
+	}
+}
+
+TapeRef TapeRef::operator[](size_t index) const
+{
+	if (!isArray() || index >= size()) {
+		return {};
+	}
+
+	TapeRef ref(tape_, strings_, index_ + 2);
+	while (index > 0) {
+		ref.index_ = ref.next();
+		index -= 1;
+	}
+
+	return ref;
+}
+
+TapeRef TapeRef::find(std::string_view key) const
+{
+	TapeRef found;
+	for (auto member: members()) {
+		if (member.key == key) {
+			found = member.value;
+		}
+	}
+
+	return found;
+}
+
+TapeIterator TapeRef::begin() const
+{
+	if (!isArray()) {
+		return *this;
+	}
+
+	return TapeRef(tape_, strings_, index_ + 2);
+}
+
+TapeIterator TapeRef::end() const
+{
+	if (!isArray()) {
+		return *this;
+	}
+
+	return TapeRef(tape_, strings_, size_t(payload()));
+}
+
+TapeMembers TapeRef::members() const
+{
+	if (!isObject()) {
+		return {*this, *this};
+	}
+
+	return {
+		{tape_, strings_, index_ + 2},
+		{tape_, strings_, size_t(payload())},
+	};
+}
+
+// Builds a Tape. Containers are written as soon as they start,
+// and their start word and count are patched in when they end.
+class TapeBuilder {
+public:
+	TapeBuilder(Tape &tape): words_(tape.words_), strings_(tape.strings_) {}
+
+	String &buffer() { return buffer_; }
+
+	bool null() {
+		count();
+		words_.push_back(tapeWord('n', 0));
+		return true;
+	}
+
+	bool boolean(Bool b) {
+		count();
+		words_.push_back(tapeWord(b ? 't' : 'f', 0));
+		return true;
+	}
+
+	bool number(Number num) {
+		count();
+		uint64_t bits;
+		memcpy(&bits, &num, sizeof(bits));
+		words_.push_back(tapeWord('d', 0));
+		words_.push_back(bits);
+		return true;
+	}
+
+	bool number(Int num) {
+		count();
+		words_.push_back(tapeWord('l', 0));
+		words_.push_back(uint64_t(num));
+		return true;
+	}
+
+	bool number(UInt num) {
+		count();
+		words_.push_back(tapeWord('u', 0));
+		words_.push_back(num);
+		return true;
+	}
+
+	bool string() {
+		count();
+		pushData('"', buffer_.data(), buffer_.size());
+		return true;
+	}
+
+	bool bstring(BString &bytes) {
+		count();
+		pushData('b', (const char *)bytes.data(), bytes.size());
+		return true;
+	}
+
+	bool beginArray() {
+		begin('[');
+		return true;
+	}
+	bool endArray() {
+		end(']');
+		return true;
+	}
+	bool beginObject() {
+		begin('{');
+		return true;
+	}
+
+	bool key() {
+		pushData('"', buffer_.data(), buffer_.size());
+		return true;
+	}
+
+	bool endObject() {
+		end('}');
+		return true;
+	}
+
+	// Add a value which has already been parsed
+	void value(const Value &v) {
+		if (auto *b = v.as<Bool>(); b) {
+			boolean(*b);
+		} else if (auto *n = v.as<Number>(); n) {
+			number(*n);
+		} else if (auto *i = v.as<Int>(); i) {
+			number(*i);
+		} else if (auto *u = v.as<UInt>(); u) {
+			number(*u);
+		} else if (auto *s = v.as<String>(); s) {
+			count();
+			pushData('"', s->data(), s->size());
+		} else if (auto *sv = v.as<StringView>(); sv) {
+			count();
+			pushData('"', sv->data(), sv->size());
+		} else if (auto *bs = v.as<BString>(); bs) {
+			count();
+			pushData('b', (const char *)bs->data(), bs->size());
+		} else if (auto *arr = v.as<Array>(); arr) {
+			begin('[');
+			for (auto &val: *arr) {
+				value(*val);
+			}
+			end(']');
+		} else if (auto *obj = v.as<Object>(); obj) {
+			begin('{');
+			for (auto &[key, val]: *obj) {
+				pushData('"', key.str().data(), key.str().size());
+				value(*val);
+			}
+			end('}');
+		} else {
+			null();
+		}
+	}
+
+private:
+	struct Frame {
+		size_t start;
+		size_t count;
+	};
+
+	// Every value except keys counts towards its container's size
+	void count() {
+		if (!frames_.empty()) {
+			frames_.back().count += 1;
+		}
+	}
+
+	void begin(char tag) {
+		count();
+		frames_.push_back({words_.size(), 0});
+		words_.push_back(tapeWord(tag, 0));
+		words_.push_back(0);
+	}
+
+	void end(char tag) {
+		Frame frame = frames_.back();
+		frames_.pop_back();
+
+		words_[frame.start] |= words_.size();
+		words_[frame.start + 1] = frame.count;
+		words_.push_back(tapeWord(tag, frame.start));
+	}
+
+	void pushData(char tag, const char *data, size_t size) {
+		words_.push_back(tapeWord(tag, strings_.size()));
+		words_.push_back(size);
+		strings_.append(data, size);
+	}
+
+	std::vector<uint64_t> &words_;
+	std::string &strings_;
+	std::vector<Frame> frames_;
+	String buffer_;
+};
+
+static bool parseTapeDocument(
+	Reader &r, Tape &tape, String *err, int maxDepth)
+{
+	tape.clear();
+
+	TapeBuilder b(tape);
+	if (!parseDocument(r, b, err, maxDepth)) {
+		tape.clear();
+		return false;
+	}
+
+	return true;
+}
+
+void buildTape(const Value &v, Tape &tape)
+{
+	tape.clear();
+
+	TapeBuilder b(tape);
+	b.value(v);
+}
+
+bool parse(
+	std::istream &is, Tape &tape,
+	String *err, int maxDepth)
+{
+	Reader r(is);
+	return parseTapeDocument(r, tape, err, maxDepth);
+}
+
+bool parse(
+	std::string_view str, Tape &tape,
+	String *err, int maxDepth)
+{
+	Reader r(str.data(), str.size());
+	return parseTapeDocument(r, tape, err, maxDepth);
+}
+
+}
@@ -0,0 +1,94 @@
+#include "writer.h"
+#include "scan.h"
+
+#include <cerrno>
+#include <iostream>
+#include <unistd.h>
+
+namespace Mason {
+
+Writer::Writer(std::string &str): kind_(Kind::String), str_(&str) {}
+
+Writer::Writer(int fd): kind_(Kind::Fd), fd_(fd) {}
+
+Writer::Writer(FILE *f): kind_(Kind::File), file_(f) {}
+
+Writer::Writer(std::ostream &os): kind_(Kind::Stream), os_(&os) {}
+
+Writer::~Writer()
+{
+	drain();
+}
+
+bool Writer::flush()
+{
+	drain();
+	if (kind_ == Kind::File) {
+		ok_ = fflush(file_) == 0 && ok_;
+	} else if (kind_ == Kind::Stream) {
+		ok_ = bool(os_->flush()) && ok_;
+	}
+
+	return ok_;
+}
+
+void Writer::drain()
+{
+	output(buffer_, size_);
+	size_ = 0;
+}
+
+// Big writes don't need to go through the buffer
+void Writer::writeSlow(const char *data, size_t size)
+{
+	drain();
+	if (size < sizeof(buffer_)) {
+		memcpy(buffer_, data, size);
+		size_ = size;
+	} else {
+		output(data, size);
+	}
+}
+
+size_t unescapedPrefixSize(std::string_view str)
+{
+	return findStringSpecial((const unsigned char *)str.data(), str.size());
+}
+
+void Writer::output(const char *data, size_t size)
+{
+	if (size == 0 || !ok_) {
+		return;
+	}
+
+	switch (kind_) {
+	case Kind::String:
+		str_->append(data, size);
+		break;
+
+	case Kind::Fd:
+		while (size > 0) {
+			ssize_t n = ::write(fd_, data, size);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			} else if (n <= 0) {
+				ok_ = false;
+				return;
+			}
+
+			data += n;
+			size -= n;
+		}
+		break;
+
+	case Kind::File:
+		ok_ = fwrite(data, 1, size, file_) == size;
+		break;
+
+	case Kind::Stream:
+		ok_ = bool(os_->write(data, size));
+		break;
+	}
+}
+
+}
@@ -0,0 +1,176 @@
+#include <mason/binary.h>
+#include <mason/keys.h>
+#include <mason/mason.h>
+#include <mason/writer.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+static std::string serialize(Mason::Value &val)
+{
+	std::string out;
+	Mason::Writer w(out);
+	Mason::serialize(w, val);
+	w.flush();
+	return out;
+}
+
+static std::string encode(const Mason::Value &val)
+{
+	std::string out;
+	Mason::Writer w(out);
+	Mason::encodeBinary(w, val);
+	w.flush();
+	return out;
+}
+
+// Decoding an encoded value gives back the same value,
+// down to the types of numbers, which encodes to the same bytes again
+static void check(const std::string &doc)
+{
+	Mason::Value val;
+	std::string err;
+	if (!Mason::parse(doc, val, &err)) {
+		fail("'" + doc + "': " + err);
+		return;
+	}
+
+	std::string bin = encode(val);
+	Mason::Value decoded;
+	if (!Mason::decodeBinary(bin, decoded, &err)) {
+		fail("'" + doc + "': decoding failed: " + err);
+		return;
+	}
+
+	if (serialize(decoded) != serialize(val)) {
+		fail("'" + doc + "': got " + serialize(decoded));
+	} else if (encode(decoded) != bin) {
+		fail("'" + doc + "': encoding the decoded value changed it");
+	}
+
+	// Interned keys and values which haven't been decoded yet
+	// are encoded the same way
+	Mason::KeyTable keys;
+	Mason::Value interned;
+	if (!Mason::decodeBinary(bin, interned, &err, 100, &keys)) {
+		fail("'" + doc + "': decoding with a key table failed: " + err);
+	} else if (encode(interned) != bin) {
+		fail("'" + doc + "': interned keys changed the encoding");
+	}
+
+	Mason::Value lazy;
+	if (!Mason::parseLazy(doc, lazy, &err)) {
+		fail("'" + doc + "': parseLazy failed: " + err);
+	} else if (encode(lazy) != bin) {
+		fail("'" + doc + "': a lazy value changed the encoding");
+	}
+
+	// Every prefix of the encoding is incomplete, and must be rejected
+	// with an error rather than read past the end
+	for (size_t size = 0; size < bin.size(); ++size) {
+		Mason::Value part;
+		std::string partErr;
+		if (Mason::decodeBinary(
+				std::string_view(bin.data(), size), part, &partErr)) {
+			fail("'" + doc + "': the first " + std::to_string(size) +
+				" bytes were accepted");
+		} else if (partErr == "") {
+			fail("'" + doc + "': no error for the first " +
+				std::to_string(size) + " bytes");
+		}
+	}
+}
+
+int main()
+{
+	for (const char *doc: {
+			"null", "true", "false", "0", "-1", "1.5", "-0.0",
+			"9223372036854775807", "-9223372036854775808",
+			"18446744073709551615", "\"\"", "\"hello\"",
+			"b\"\\x00\\xff\"", "[]", "{}", "[[[]]]",
+			"[1, -2, 3.25, \"four\", b\"5\", null, true]",
+			"{a: 1, b: {a: 2, c: [{a: 3}, {b: 4}]}, \"key with spaces\": {}}",
+			"{z: 1, y: 2, x: 3, w: 4, v: 5, u: 6, t: 7, s: 8, r: 9, q: 10}",
+			"{\"\\u00e9\\n\": \"\\u2603\", \"\": \"\"}"}) {
+		check(doc);
+	}
+
+	// A larger document, with enough keys for key references
+	// to need more than one byte
+	std::string big = "[";
+	for (int i = 0; i < 100; ++i) {
+		big += "{key" + std::to_string(i) + ": " + std::to_string(i * 1000003) +
+			", name: \"" + std::string(i, 'x') + "\", list: [" +
+			std::to_string(i * 0.5) + ", " + std::to_string(-i) + "]}, ";
+	}
+	big += "]";
+	check(big);
+
+	// Things which aren't valid encodings
+	for (std::string bin: {
+			std::string(""), std::string("MSB"), std::string("MSB\2\0", 5),
+			std::string("{\"a\": 1}"), std::string("MSB\1\0\0", 6),
+			std::string("MSB\1\x0a", 5),
+			std::string("MSB\1\x09\x01\x01\0", 8),
+			std::string("MSB\1\x04\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\0", 15)}) {
+		Mason::Value val;
+		std::string err;
+		if (Mason::decodeBinary(bin, val, &err)) {
+			fail("invalid encoding of " + std::to_string(bin.size()) +
+				" bytes was accepted");
+		} else if (err == "") {
+			fail("no error for invalid encoding of " +
+				std::to_string(bin.size()) + " bytes");
+		}
+	}
+
+	{
+		std::string bin = "MSB\1";
+		for (int i = 0; i < 10; ++i) {
+			bin += '\x08';
+			bin += '\x01';
+		}
+		bin += '\0';
+		Mason::Value val;
+		std::string err;
+		if (Mason::decodeBinary(bin, val, &err, 5)) {
+			fail("nesting limit was ignored");
+		} else if (err.find("Nesting limit exceeded") == std::string::npos) {
+			fail("nesting limit: got '" + err + "'");
+		}
+	}
+
+	// Damaged input is either rejected or decoded into some value,
+	// but never read out of bounds
+	{
+		Mason::Value val;
+		Mason::parse(big, val);
+		std::string bin = encode(val);
+		std::mt19937 rng(1234);
+		for (int i = 0; i < 1000; ++i) {
+			std::string damaged = bin;
+			damaged[4 + rng() % (damaged.size() - 4)] = char(rng());
+			Mason::Value out;
+			std::string err;
+			if (!Mason::decodeBinary(damaged, out, &err) && err == "") {
+				fail("no error for damaged input");
+			}
+		}
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,161 @@
+#include <mason/codec.h>
+#include <mason/mason.h>
+
+#include <iostream>
+#include <string>
+
+using namespace std::string_literals;
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+static Mason::BString bytes(const std::string &str)
+{
+	return Mason::BString(str.begin(), str.end());
+}
+
+// Every byte value, a few times over, so that both the vectorized
+// loops and the code after them get to see all of them
+static Mason::BString allBytes(size_t size)
+{
+	Mason::BString data;
+	for (size_t i = 0; i < size; ++i) {
+		data.push_back((i * 7) & 0xff);
+	}
+	return data;
+}
+
+static void checkBase64(const std::string &data, const std::string &expected)
+{
+	std::string out(Mason::base64Size(data.size()), '\0');
+	out.resize(Mason::encodeBase64(
+		(const unsigned char *)data.data(), data.size(), out.data()));
+	if (out != expected) {
+		fail("base64 of '" + data + "': got '" + out + "'");
+	}
+}
+
+static void checkHex(const Mason::BString &data)
+{
+	std::string hex(Mason::hexSize(data.size()), '\0');
+	hex.resize(Mason::encodeHex(data.data(), data.size(), hex.data()));
+
+	Mason::BString decoded;
+	if (!Mason::decodeHex(hex, decoded) || decoded != data) {
+		fail("hex round trip of " + std::to_string(data.size()) + " bytes");
+	}
+
+	std::string escapes(Mason::hexEscapeSize(data.size()), '\0');
+	escapes.resize(Mason::encodeHexEscapes(
+		data.data(), data.size(), escapes.data()));
+
+	decoded.clear();
+	size_t n = Mason::decodeHexEscapes(escapes, decoded);
+	if (n != escapes.size() || decoded != data) {
+		fail("hex escape round trip of " + std::to_string(data.size()) + " bytes");
+	}
+}
+
+int main()
+{
+	checkBase64("", "");
+	checkBase64("f", "Zg==");
+	checkBase64("fo", "Zm8=");
+	checkBase64("foo", "Zm9v");
+	checkBase64("foob", "Zm9vYg==");
+	checkBase64("fooba", "Zm9vYmE=");
+	checkBase64("foobar", "Zm9vYmFy");
+	checkBase64(
+		"The quick brown fox jumps over the lazy dog",
+		"VGhlIHF1aWNrIGJyb3duIGZveCBqdW1wcyBvdmVyIHRoZSBsYXp5IGRvZw==");
+
+	for (size_t size: {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 100, 1000}) {
+		checkHex(allBytes(size));
+	}
+
+	Mason::BString out;
+	if (!Mason::decodeHex("00FFaB7c0123456789abcdefABCDEF99", out) ||
+			out != bytes("\x00\xff\xab\x7c\x01\x23\x45\x67\x89\xab\xcd\xef\xab\xcd\xef\x99"s)) {
+		fail("mixed case hex");
+	}
+
+	for (const char *bad: {"0", "0g", "000000000000000g", "0000000000000000000g", "+0"}) {
+		out.clear();
+		if (Mason::decodeHex(bad, out)) {
+			fail(std::string("invalid hex '") + bad + "' was accepted");
+		}
+	}
+
+	// Decoding hex escapes stops at the first thing which isn't one,
+	// wherever it is
+	std::string escapes;
+	for (int i = 0; i < 10; ++i) {
+		escapes += "\\x4a";
+	}
+	for (size_t stop = 0; stop < escapes.size(); stop += 4) {
+		for (const char *end: {"\\", "\\x", "\\x4", "\\xg0", "\\x0G", "\\n", "x"}) {
+			std::string str = escapes.substr(0, stop) + end + "\\x00";
+			out.clear();
+			size_t n = Mason::decodeHexEscapes(str, out);
+			if (n != stop || out != Mason::BString(stop / 4, 0x4a)) {
+				fail("hex escapes stopping at '" + std::string(end) +
+					"' after " + std::to_string(stop / 4));
+			}
+		}
+	}
+
+	// Decoders append to what's already there
+	out = bytes("ab");
+	Mason::decodeHexEscapes("\\x63", out);
+	Mason::decodeHex("64", out);
+	if (out != bytes("abcd")) {
+		fail("decoders don't append");
+	}
+
+	// The parser decodes binary strings with decodeHexEscapes
+	Mason::BString data = allBytes(300);
+	std::string doc = "b\"x";
+	for (size_t i = 0; i < data.size(); ++i) {
+		char esc[4];
+		Mason::encodeHexEscapes(&data[i], 1, esc);
+		doc.append(esc, 4);
+		if (i % 50 == 0) {
+			doc += "y\\n";
+		}
+	}
+	doc += "z\"";
+
+	Mason::BString expected = bytes("x");
+	for (size_t i = 0; i < data.size(); ++i) {
+		expected.push_back(data[i]);
+		if (i % 50 == 0) {
+			expected.push_back('y');
+			expected.push_back('\n');
+		}
+	}
+	expected.push_back('z');
+
+	Mason::Value val;
+	std::string err;
+	if (!Mason::parse(doc, val, &err)) {
+		fail("parse binary string: " + err);
+	} else if (!val.is<Mason::BString>() || *val.as<Mason::BString>() != expected) {
+		fail("parse binary string: wrong contents");
+	}
+
+	if (Mason::parse("b\"\\x0g\"", val)) {
+		fail("invalid hex escape in binary string was accepted");
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
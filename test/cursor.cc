@@ -0,0 +1,159 @@
+#include "recorder.h"
+
+#include <mason/cursor.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using Token = Mason::Cursor::Token;
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+// Read every token with a cursor, reporting it to a Recorder
+// the same way the event-based parser would
+static bool readAll(Mason::Cursor &cursor, Recorder &rec)
+{
+	while (true) {
+		bool ok = true;
+		switch (cursor.next()) {
+		case Token::Null:
+			ok = rec.onNull();
+			break;
+
+		case Token::Bool: {
+			Mason::Bool b;
+			ok = cursor.readBool(b) && rec.onBool(b);
+			break;
+		}
+
+		case Token::Number: {
+			Mason::Int i;
+			Mason::UInt u;
+			Mason::Number num;
+			if (cursor.readInt(i)) {
+				ok = rec.onInt(i);
+			} else if (cursor.readUInt(u)) {
+				ok = rec.onUInt(u);
+			} else {
+				ok = cursor.readNumber(num) && rec.onNumber(num);
+			}
+			break;
+		}
+
+		case Token::String: {
+			std::string_view str;
+			ok = cursor.readString(str) && rec.onString(str);
+			break;
+		}
+
+		case Token::BString: {
+			Mason::BString bytes;
+			ok = cursor.readBString(bytes) && rec.onBString(bytes.data(), bytes.size());
+			break;
+		}
+
+		case Token::Key: {
+			std::string_view key;
+			ok = cursor.readKey(key) && rec.onKey(key);
+			break;
+		}
+
+		case Token::BeginArray: ok = rec.onBeginArray(); break;
+		case Token::EndArray: ok = rec.onEndArray(); break;
+		case Token::BeginObject: ok = rec.onBeginObject(); break;
+		case Token::EndObject: ok = rec.onEndObject(); break;
+		case Token::End: return true;
+		case Token::Error: return false;
+		case Token::None: return false;
+		}
+
+		if (!ok) {
+			return false;
+		}
+	}
+}
+
+// A cursor which reads everything sees the same events, and the same
+// errors, as the event-based parser, from memory and from a stream
+static void check(const std::string &doc)
+{
+	Recorder expected;
+	std::string expectedErr;
+	bool expectedOk = Mason::parse(std::string_view(doc), expected, &expectedErr);
+
+	for (int fromStream = 0; fromStream < 2; ++fromStream) {
+		std::istringstream is(doc);
+		Mason::Cursor cursor = fromStream ?
+			Mason::Cursor(is) : Mason::Cursor(std::string_view(doc));
+		Recorder rec;
+		bool ok = readAll(cursor, rec);
+		if (ok != expectedOk || cursor.error() != expectedErr) {
+			fail("'" + doc + "': got error '" + cursor.error() +
+				"', expected '" + expectedErr + "'");
+		} else if (ok && rec.log != expected.log) {
+			fail("'" + doc + "': got events\n" + rec.log +
+				"expected\n" + expected.log);
+		}
+	}
+}
+
+int main()
+{
+	for (const char *doc: {
+			"null", "true", "1.5", "-3", "18446744073709551615", "\"str\"",
+			"[]", "{}", "[1, [2, [3]], {a: {}}]",
+			"a: 1\nb: [true, false, null]\n\"c d\": {e: 'f'}",
+			"{x: 0x10, y: 1e3, z: -0.0, w: b\"\\x00\\x01ab\"}",
+			"// comment\n[1 /* two */, 2]\n",
+			"{s: |multi\n|line\n, r: r#\"raw \"string\"\"#}",
+			"[1, 2", "[1 2]", "{a 1}", "{a: 1,, b: 2}", "[\"unterminated]",
+			"[nope]", "{a: 1} x"}) {
+		check(doc);
+	}
+
+	// Skipping keys and containers moves past their values in one go
+	std::string doc =
+		"{skip: {a: [1, 2, {b: 3}], c: \"}]\"}, items: [1, 2, 3],"
+		" more: [[], {}], last: true}";
+	Mason::Cursor cursor{std::string_view(doc)};
+	Recorder rec;
+	std::string_view key;
+	if (cursor.next() != Token::BeginObject) {
+		fail("skip: no object");
+	}
+	while (cursor.next() == Token::Key && cursor.readKey(key)) {
+		rec.onKey(key);
+		if (key == "items") {
+			if (cursor.next() != Token::BeginArray || !cursor.skipValue()) {
+				fail("skip: skipping an array");
+			}
+		} else if (key != "last" && !cursor.skipValue()) {
+			fail("skip: skipping a key");
+		} else if (key == "last") {
+			Mason::Bool b = false;
+			if (cursor.next() != Token::Bool || !cursor.readBool(b) || !b) {
+				fail("skip: reading after skipping");
+			}
+		}
+	}
+	if (cursor.token() != Token::EndObject || cursor.next() != Token::End) {
+		fail("skip: didn't end properly: " + cursor.error());
+	}
+	if (rec.log != "key skip\nkey items\nkey more\nkey last\n") {
+		fail("skip: got keys\n" + rec.log);
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include <mason/keys.h>
+#include <mason/mason.h>
+
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void expect(bool ok, const std::string &what)
+{
+	if (!ok) {
+		std::cerr << "FAIL: " << what << '\n';
+		failures += 1;
+	}
+}
+
+int main()
+{
+	// Keys compare with literals, std::strings and string_views,
+	// on either side, as they did when they were std::strings
+	Mason::Object obj{{"a", Mason::Value::make(Mason::Int(1))}};
+	std::string a = "a";
+	std::string_view b = "b";
+	for (auto &[k, v]: obj) {
+		expect(k == "a" && "a" == k, "key == literal");
+		expect(!(k != "a") && !("a" != k), "key != literal");
+		expect(k == a && a == k && !(k != a) && !(a != k), "key == std::string");
+		expect(k != b && b != k && !(k == b) && !(b == k), "key != string_view");
+		expect(k == Mason::Key("a") && k != Mason::Key("b"), "key == key");
+	}
+
+	// Interned keys compare the same way
+	Mason::KeyTable keys;
+	Mason::Key interned(keys.intern("a"));
+	expect(interned == "a" && interned == a && interned == obj.begin()->first,
+		"interned key == string");
+
+	// A bounded table stops interning new keys, but still finds old ones
+	Mason::KeyTable bounded(2);
+	expect(bounded.intern("x") && bounded.intern("y"), "interning below the limit");
+	expect(!bounded.intern("z"), "interning past the limit");
+	expect(bounded.intern("x") == bounded.intern("x"), "finding an interned key");
+	expect(bounded.size() == 2, "bounded table size");
+
+	Mason::Value val;
+	expect(Mason::parse("{x: 1, z: 2}", val, nullptr, 100, &bounded), "parse with a full table");
+	auto *parsed = val.as<Mason::Object>();
+	expect(parsed && parsed->begin()->first.interned() &&
+		!(parsed->begin() + 1)->first.interned() &&
+		(parsed->begin() + 1)->first == "z", "keys past the limit hold their own strings");
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include <mason/mason.h>
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lazy values don't make every other value bigger
+static_assert(sizeof(Mason::Value) == sizeof(Mason::Value::V));
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+int main()
+{
+	std::string doc = "[";
+	for (int i = 0; i < 1000; ++i) {
+		doc += "{a: " + std::to_string(i) + ", b: [1, 2, 3]}, ";
+	}
+	doc += "nope]";
+
+	Mason::Value val;
+	std::string err;
+	if (!Mason::parseLazy(doc, val, &err)) {
+		fail("parseLazy: " + err);
+		return 1;
+	}
+
+	// Several threads reading the same values decode each of them once
+	const Mason::Value &root = val;
+	std::vector<std::thread> threads;
+	std::vector<int> sums(4);
+	for (int &sum: sums) {
+		threads.emplace_back([&root, &sum] {
+			for (auto &elem: *root.as<Mason::Array>()) {
+				const Mason::Value &child = *elem;
+				if (auto *obj = child.as<Mason::Object>(); obj) {
+					if (auto *a = obj->at("a")->as<Mason::Int>(); a) {
+						sum += *a;
+					}
+				}
+			}
+		});
+	}
+	for (auto &thread: threads) {
+		thread.join();
+	}
+
+	for (int sum: sums) {
+		if (sum != 999 * 1000 / 2) {
+			fail("concurrent reads got " + std::to_string(sum));
+		}
+	}
+
+	// An invalid value reads as null, and keeps reporting its error
+	auto &arr = *val.as<Mason::Array>();
+	Mason::Value &bad = *arr.back();
+	if (!bad.is<Mason::Null>()) {
+		fail("invalid value isn't null");
+	}
+	for (int i = 0; i < 2; ++i) {
+		err.clear();
+		if (bad.load(&err) || err.empty()) {
+			fail("invalid value doesn't report an error");
+		}
+	}
+
+	// A copy doesn't depend on the original being loaded
+	Mason::Value copy = *arr.front();
+	auto *obj = copy.as<Mason::Object>();
+	if (!obj || !obj->at("b")->is<Mason::Array>()) {
+		fail("copy of a lazy value");
+	}
+
+	// Values have to end where skipping over them did,
+	// and values replaced by a later duplicate key are still checked
+	for (const char *bad: {
+			"[1_0]", "[1.5.5]", "[true_]", "{a: 1_0}", "{a: 1.5.5, b: 2}",
+			"{a: [1_0], a: 2}", "{a: {b: -inf}, a: true}"}) {
+		Mason::Value lazy;
+		err.clear();
+		bool ok = Mason::parseLazy(bad, lazy, &err);
+		if (auto *arr = lazy.as<Mason::Array>(); ok && arr) {
+			for (auto &elem: *arr) {
+				ok = ok && elem->load(&err);
+			}
+		} else if (auto *obj = lazy.as<Mason::Object>(); ok && obj) {
+			for (auto &[key, elem]: *obj) {
+				ok = ok && elem->load(&err);
+			}
+		}
+
+		std::string expected;
+		Mason::parse(bad, lazy, &expected);
+		if (ok || err != expected) {
+			fail(std::string("lazy '") + bad + "': got '" + err +
+				"', expected '" + expected + "'");
+		}
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
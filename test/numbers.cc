@@ -0,0 +1,65 @@
+#include <mason/mason.h>
+
+#include <iostream>
+#include <string>
+#include <math.h>
+
+static int failures = 0;
+
+template<typename T>
+static void check(const std::string &str, T expected)
+{
+	Mason::Value v;
+	std::string err;
+	if (!Mason::parse(str, v, &err)) {
+		std::cerr << "FAIL: " << str.substr(0, 40) << ": " << err << '\n';
+		failures += 1;
+		return;
+	}
+
+	T *num = v.as<T>();
+	if (!num || *num != expected || signbit(double(*num)) != signbit(double(expected))) {
+		std::cerr << "FAIL: " << str.substr(0, 40) << ": expected "
+			<< expected << '\n';
+		failures += 1;
+	}
+}
+
+int main()
+{
+	// Integers which fit in 64 bits take the fast path
+	check<Mason::Int>("0", 0);
+	check<Mason::Int>("42", 42);
+	check<Mason::Int>("-7", -7);
+	check<Mason::Int>("9223372036854775807", INT64_MAX);
+	check<Mason::Int>("-9223372036854775808", INT64_MIN);
+	check<Mason::UInt>("18446744073709551615", UINT64_MAX);
+	check<Mason::Number>("18446744073709551616", 18446744073709551616.0);
+	check<Mason::Number>("-0", -0.0);
+
+	// Short decimals
+	check<Mason::Number>("1.5", 1.5);
+	check<Mason::Number>("0.1", 0.1);
+	check<Mason::Number>("-2.5e3", -2500.0);
+	check<Mason::Number>("1e22", 1e22);
+	check<Mason::Number>("1e23", 1e23);
+
+	// Exactly halfway between two doubles, so that the rounding
+	// only depends on a digit past the ones which are kept
+	std::string halfway = "9007199254740993";
+	check<Mason::Int>(halfway, 9007199254740993);
+	check<Mason::Number>(halfway + ".0", 9007199254740992.0);
+	check<Mason::Number>(
+		halfway + "." + std::string(752, '0') + "1", 9007199254740994.0);
+	check<Mason::Number>(
+		halfway + "." + std::string(800, '0') + "1", 9007199254740994.0);
+	check<Mason::Number>(
+		halfway + "." + std::string(800, '0'), 9007199254740992.0);
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
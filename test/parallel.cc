@@ -0,0 +1,82 @@
+#include <mason/mason.h>
+#include <mason/writer.h>
+
+#include <iostream>
+#include <random>
+#include <string>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+static std::string serialize(Mason::Value &val)
+{
+	std::string out;
+	Mason::Writer w(out);
+	Mason::serialize(w, val);
+	w.flush();
+	return out;
+}
+
+// parseParallel must accept exactly what parse accepts,
+// with the same result or the same error
+static void check(const std::string &doc)
+{
+	Mason::Value expected;
+	std::string expectedErr;
+	bool expectedOk = Mason::parse(doc, expected, &expectedErr);
+
+	Mason::Value val;
+	std::string err;
+	bool ok = Mason::parseParallel(doc, val, &err, 100, 4);
+
+	if (ok != expectedOk || err != expectedErr) {
+		fail("'" + doc + "': got " + (ok ? "success" : "'" + err + "'") +
+			", expected " + (expectedOk ? "success" : "'" + expectedErr + "'"));
+	} else if (ok && serialize(val) != serialize(expected)) {
+		fail("'" + doc + "': got a different value");
+	}
+}
+
+int main()
+{
+	for (const char *doc: {
+			"[]", "{}", "[1, 2, 3]", "{a: 1, b: [2, 3], c: {d: \"e\"}}",
+			"a: 1\nb: 2", "[1_0]", "[1.5.5]", "[true_]", "[1, 2 3]",
+			"{a: 1_0}", "{a: 1, a: 2}", "{a: [1_0], a: 2}",
+			"{\"\\n\": {x: -inf}, y: 1, \"\\n\": true}",
+			"[\"a\"b]", "[r\"a\"x]", "[b\"\\x0g\"]", "[|a\n|b\n]",
+			"[{a: 1} {b: 2}]", "[[1, 2], [3 4]]", "[1, 2,]", "[1, 2"}) {
+		check(doc);
+	}
+
+	// Larger documents, so that the elements are spread over threads,
+	// with random damage
+	std::string base = "[";
+	for (int i = 0; i < 300; ++i) {
+		base += "{id: " + std::to_string(i) +
+			", name: \"n" + std::to_string(i) + "\", tags: [1.5, -2, true]}, ";
+	}
+	base += "]";
+	check(base);
+
+	std::mt19937 rng(1234);
+	const std::string junk = "_.,:[]{}\"' \n0e-+x";
+	for (int i = 0; i < 300; ++i) {
+		std::string doc = base;
+		size_t pos = 1 + rng() % (doc.size() - 2);
+		doc.insert(pos, 1, junk[rng() % junk.size()]);
+		check(doc);
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+#include "recorder.h"
+
+#include <mason/push.h>
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+// The first line where two event logs differ
+static std::string firstDifference(const std::string &a, const std::string &b)
+{
+	std::istringstream as(a), bs(b);
+	std::string al, bl;
+	for (int line = 1;; ++line) {
+		bool aok = (bool)std::getline(as, al);
+		bool bok = (bool)std::getline(bs, bl);
+		if (!aok && !bok) {
+			return "";
+		} else if (aok != bok || al != bl) {
+			return "event " + std::to_string(line) + ": got '" +
+				(aok ? al : "<end>") + "', expected '" + (bok ? bl : "<end>") + "'";
+		}
+	}
+}
+
+// Feeding a document in pieces gives the same events and the same
+// error as parsing it in one go
+static void check(const std::string &doc, std::mt19937 &rng)
+{
+	Recorder expected;
+	std::string expectedErr;
+	bool expectedOk = Mason::parse(std::string_view(doc), expected, &expectedErr);
+
+	for (int mode = 0; mode < 3; ++mode) {
+		Recorder rec;
+		Mason::PushParser parser(rec);
+		bool ok = true;
+		size_t i = 0;
+		while (ok && i < doc.size()) {
+			size_t n = 1;
+			if (mode == 1) {
+				n = 1 + rng() % 16;
+			} else if (mode == 2) {
+				n = doc.size();
+			}
+			n = std::min(n, doc.size() - i);
+			ok = parser.feed(doc.data() + i, n);
+			i += n;
+		}
+		ok = ok && parser.finish();
+
+		const char *how[] = {"bytes", "random pieces", "one piece"};
+		std::string what = (doc.size() > 60 ? doc.substr(0, 60) + "..." : doc) +
+			" in " + how[mode];
+		std::string diff = firstDifference(rec.log, expected.log);
+		if (ok != expectedOk || parser.error() != expectedErr) {
+			fail(what + ": got error '" + parser.error() +
+				"', expected '" + expectedErr + "'");
+		} else if (diff != "") {
+			fail(what + ": " + diff);
+		} else if (ok != parser.done()) {
+			fail(what + ": done() is wrong");
+		}
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1234);
+	for (const char *doc: {
+			"null", "true", "1.5", "-3", "12345678901234567890", "\"str\"",
+			"[]", "{}", "[1, [2, [3]], {a: {}}]",
+			"a: 1\nb: [true, false, null]\n\"c d\": {e: 'f'}",
+			"{x: 0x10, y: 1e3, z: -0.0, w: b\"\\x00\\x01ab\"}",
+			"// comment\n[1 /* two */, 2]\n",
+			"{s: |multi\n|line\n, r: r#\"raw \"string\"\"#}",
+			"{\"long key with \\\"escapes\\\" in it\": \"and a long \\u00e9 value\"}",
+			"[1, 2", "[1 2]", "{a 1}", "{a: 1,, b: 2}", "[\"unterminated]",
+			"[nope]", "{a: 1} x", "[1_0]", "", "   "}) {
+		check(doc, rng);
+	}
+
+	std::string big = "[";
+	for (int i = 0; i < 200; ++i) {
+		big += "{id: " + std::to_string(i) + ", name: \"n" + std::to_string(i) +
+			"\", v: [1.25, -2, true, null]}, ";
+	}
+	big += "]";
+	check(big, rng);
+
+	for (int i = 0; i < 50; ++i) {
+		std::string doc = big;
+		doc.insert(1 + rng() % (doc.size() - 2), 1, "_.,:[]{}\"' \n"[rng() % 12]);
+		check(doc, rng);
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <mason/mason.h>
+
+#include <charconv>
+#include <string>
+
+// A Handler which writes down every event it gets, one per line,
+// so that different ways of parsing a document can be compared
+class Recorder: public Mason::Handler {
+public:
+	std::string log;
+
+	bool onNull() override { return add("null"); }
+	bool onBool(Mason::Bool b) override { return add(b ? "true" : "false"); }
+	bool onNumber(Mason::Number num) override { return addNumber("num ", num); }
+	bool onInt(Mason::Int num) override { return addNumber("int ", num); }
+	bool onUInt(Mason::UInt num) override { return addNumber("uint ", num); }
+	bool onString(std::string_view str) override { return add("str ", str); }
+
+	bool onBString(const unsigned char *data, size_t size) override
+	{
+		return add("bstr ", std::string_view((const char *)data, size));
+	}
+
+	bool onBeginArray() override { return add("["); }
+	bool onEndArray() override { return add("]"); }
+	bool onBeginObject() override { return add("{"); }
+	bool onKey(std::string_view key) override { return add("key ", key); }
+	bool onEndObject() override { return add("}"); }
+
+private:
+	bool add(std::string_view what, std::string_view str = "")
+	{
+		log += what;
+		log += str;
+		log += '\n';
+		return true;
+	}
+
+	template<typename T>
+	bool addNumber(std::string_view what, T num)
+	{
+		char buf[64];
+		auto res = std::to_chars(buf, buf + sizeof(buf), num);
+		return add(what, std::string_view(buf, res.ptr - buf));
+	}
+};
@@ -0,0 +1,127 @@
+#include <mason/mason.h>
+#include <mason/writer.h>
+
+#include <iostream>
+#include <string>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+static std::string serialize(Mason::Value &val, int threads)
+{
+	std::string out;
+	Mason::Writer w(out);
+	if (threads < 0) {
+		Mason::serialize(w, val);
+	} else {
+		Mason::serializeParallel(w, val, threads);
+	}
+	w.flush();
+	return out;
+}
+
+// serializeParallel writes exactly the same bytes as serialize,
+// however many threads it uses
+static void check(const std::string &what, Mason::Value &val)
+{
+	std::string expected = serialize(val, -1);
+	for (int threads: {0, 1, 2, 3, 8, 64}) {
+		std::string out = serialize(val, threads);
+		if (out != expected) {
+			size_t i = 0;
+			while (i < out.size() && i < expected.size() && out[i] == expected[i]) {
+				i += 1;
+			}
+			fail(what + " with " + std::to_string(threads) +
+				" threads: differs at byte " + std::to_string(i) + " of " +
+				std::to_string(expected.size()));
+		}
+	}
+}
+
+static void check(const std::string &doc)
+{
+	std::string what = doc.size() > 40 ? doc.substr(0, 40) + "..." : doc;
+	Mason::Value val;
+	std::string err;
+	if (!Mason::parse(doc, val, &err)) {
+		fail(what + ": " + err);
+		return;
+	}
+	check(what, val);
+
+	// Strings which point into the input, and values which haven't been
+	// decoded yet, are written the same way as ordinary ones
+	Mason::Value inPlace;
+	if (!Mason::parseInPlace(doc, inPlace, &err)) {
+		fail(what + " in place: " + err);
+	} else {
+		check(what + " in place", inPlace);
+	}
+
+	Mason::Value lazy;
+	if (!Mason::parseLazy(doc, lazy, &err)) {
+		fail(what + " lazily: " + err);
+	} else {
+		check(what + " lazily", lazy);
+	}
+}
+
+// An array of n elements, each of which is an object holding
+// an array of n / 10 elements, so that there's work to split
+// at more than one level
+static std::string nested(int n)
+{
+	std::string doc = "[";
+	for (int i = 0; i < n; ++i) {
+		doc += "{id: " + std::to_string(i) + ", \"name with spaces\": \"item\\t" +
+			std::to_string(i) + "\", data: b\"\\x0" + std::to_string(i % 10) +
+			"\", list: [";
+		for (int j = 0; j < n / 10; ++j) {
+			doc += std::to_string(j * 0.25) + ", ";
+		}
+		doc += "], empty: {}, nothing: [], null: null}, ";
+	}
+	return doc + "]";
+}
+
+// An object of n members
+static std::string wide(int n)
+{
+	std::string doc = "{";
+	for (int i = 0; i < n; ++i) {
+		doc += "key" + std::to_string(i) + ": [" + std::to_string(i) +
+			", \"" + std::string(i % 7, 'x') + "\"], ";
+	}
+	return doc + "}";
+}
+
+int main()
+{
+	for (const char *doc: {
+			"null", "true", "1.5", "-3", "18446744073709551615",
+			"\"a \\\"string\\\"\\n\"", "b\"\\x00\"", "[]", "{}",
+			"[1, [2, [3]]]", "{a: {b: {c: {}}}}", "a: 1\nb: [2, 3]\n"}) {
+		check(doc);
+	}
+
+	// Either side of the size at which arrays and objects are split
+	for (int n: {1, 10, 63, 64, 65, 100, 129, 1000}) {
+		check(nested(n));
+		check(wide(n));
+		check("[" + nested(n) + ", " + wide(n) + "]");
+		check("{first: " + wide(n) + ", second: " + nested(n) + "}");
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+#include <mason/snapshot.h>
+#include <mason/writer.h>
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+// Write out everything about a value, including the types of numbers
+// and the order and repetition of keys, so that tapes can be compared
+static void dump(Mason::TapeRef ref, std::string &out)
+{
+	char buf[64];
+	auto num = [&](auto n) {
+		auto res = std::to_chars(buf, buf + sizeof(buf), n);
+		out.append(buf, res.ptr - buf);
+	};
+
+	if (ref.isNull()) {
+		out += "null";
+	} else if (ref.isBool()) {
+		out += ref.boolean() ? "true" : "false";
+	} else if (ref.isNumber()) {
+		out += "num ";
+		num(ref.number());
+	} else if (ref.isInt()) {
+		out += "int ";
+		num(ref.integer());
+	} else if (ref.isUInt()) {
+		out += "uint ";
+		num(ref.uinteger());
+	} else if (ref.isString()) {
+		out += "str ";
+		out += ref.string();
+	} else if (ref.isBString()) {
+		out += "bstr ";
+		out.append((const char *)ref.bytes(), ref.size());
+	} else if (ref.isArray()) {
+		out += "[";
+		for (auto elem: ref) {
+			dump(elem, out);
+			out += ", ";
+		}
+		out += "]";
+	} else if (ref.isObject()) {
+		out += "{";
+		for (auto member: ref.members()) {
+			out += member.key;
+			out += ": ";
+			dump(member.value, out);
+			out += ", ";
+		}
+		out += "}";
+	}
+}
+
+static std::string dump(Mason::TapeRef ref)
+{
+	std::string out;
+	dump(ref, out);
+	return out;
+}
+
+static std::string tempPath()
+{
+	const char *dir = getenv("TMPDIR");
+	std::string path = std::string(dir ? dir : "/tmp") + "/mason-snapshot-XXXXXX";
+	int fd = mkstemp(path.data());
+	if (fd < 0) {
+		perror(path.c_str());
+		exit(1);
+	}
+	::close(fd);
+	return path;
+}
+
+static void writeFile(const std::string &path, const std::string &data)
+{
+	FILE *f = fopen(path.c_str(), "wb");
+	if (!f || fwrite(data.data(), 1, data.size(), f) != data.size()) {
+		perror(path.c_str());
+		exit(1);
+	}
+	fclose(f);
+}
+
+// A snapshot of a tape, and of a value, opens as the same document
+static void check(const std::string &doc, const std::string &path)
+{
+	Mason::Tape tape;
+	std::string err;
+	if (!Mason::parse(doc, tape, &err)) {
+		fail("'" + doc + "': " + err);
+		return;
+	}
+	std::string expected = dump(tape.root());
+
+	std::string data;
+	Mason::Writer w(data);
+	Mason::writeSnapshot(w, tape);
+	w.flush();
+	writeFile(path, data);
+
+	Mason::Snapshot snap;
+	if (!snap.open(path.c_str(), &err)) {
+		fail("'" + doc + "': " + err);
+	} else if (dump(snap.root()) != expected) {
+		fail("'" + doc + "': got " + dump(snap.root()));
+	}
+
+	// Values don't keep repeated keys, so compare with the value's own tape
+	Mason::Value val;
+	Mason::parse(doc, val);
+	Mason::Tape valTape;
+	Mason::buildTape(val, valTape);
+
+	std::string valData;
+	Mason::Writer vw(valData);
+	Mason::writeSnapshot(vw, val);
+	vw.flush();
+	writeFile(path, valData);
+
+	if (!snap.open(path.c_str(), &err)) {
+		fail("'" + doc + "' from a value: " + err);
+	} else if (dump(snap.root()) != dump(valTape.root())) {
+		fail("'" + doc + "' from a value: got " + dump(snap.root()));
+	}
+}
+
+static void checkInvalid(
+	const std::string &what, const std::string &data,
+	const std::string &path, const std::string &expectedErr)
+{
+	writeFile(path, data);
+	Mason::Snapshot snap;
+	std::string err;
+	if (snap.open(path.c_str(), &err)) {
+		fail(what + " was accepted");
+	} else if (err != path + ": " + expectedErr) {
+		fail(what + ": got '" + err + "'");
+	} else if (snap.root()) {
+		fail(what + ": root is still set");
+	}
+}
+
+int main()
+{
+	std::string path = tempPath();
+
+	for (const char *doc: {
+			"null", "true", "false", "1.5", "-3", "18446744073709551615",
+			"\"hello\"", "b\"\\x00\\x01\"", "[]", "{}", "[[], {}, [[]]]",
+			"[1, -2, 3.25, \"four\", b\"5\", null, true]",
+			"{host: \"localhost\", port: 8080, tls: {enabled: false}}",
+			"{a: 1, b: 2, a: 3}",
+			"a: [1, 2]\nb: {c: \"d\"}\n"}) {
+		check(doc, path);
+	}
+
+	std::string big = "[";
+	for (int i = 0; i < 1000; ++i) {
+		big += "{id: " + std::to_string(i) + ", name: \"item " +
+			std::to_string(i) + "\", tags: [\"x\", \"y\"]}, ";
+	}
+	big += "]";
+	check(big, path);
+
+	// Lookups go straight to the mapped file
+	{
+		Mason::Value val;
+		Mason::parse("{host: \"localhost\", port: 8080, a: 1, a: 2}", val);
+		std::string data;
+		Mason::Writer w(data);
+		Mason::writeSnapshot(w, val);
+		w.flush();
+		writeFile(path, data);
+
+		Mason::Snapshot snap;
+		std::string err;
+		if (!snap.open(path.c_str(), &err)) {
+			fail("lookups: " + err);
+		} else {
+			if (snap.root().find("port").integer() != 8080) {
+				fail("lookups: wrong port");
+			}
+			if (snap.root().find("host").string() != "localhost") {
+				fail("lookups: wrong host");
+			}
+			if (snap.root().find("a").integer() != 2) {
+				fail("lookups: the last 'a' didn't win");
+			}
+			if (snap.root().find("missing")) {
+				fail("lookups: found a missing key");
+			}
+		}
+
+		// From a pipe, which is read into memory rather than mapped
+		int fds[2];
+		if (pipe(fds) != 0) {
+			perror("pipe");
+			return 1;
+		}
+		if (write(fds[1], data.data(), data.size()) != ssize_t(data.size())) {
+			perror("write");
+			return 1;
+		}
+		::close(fds[1]);
+
+		Mason::Snapshot piped;
+		if (!piped.open(fds[0], &err)) {
+			fail("pipe: " + err);
+		} else if (dump(piped.root()) != dump(snap.root())) {
+			fail("pipe: got " + dump(piped.root()));
+		}
+		::close(fds[0]);
+
+		snap.close();
+		if (snap.root()) {
+			fail("root is still set after close");
+		}
+	}
+
+	// Files which aren't complete snapshots
+	{
+		Mason::Tape tape;
+		Mason::parse("[1, \"two\", {three: 3}]", tape);
+		std::string data;
+		Mason::Writer w(data);
+		Mason::writeSnapshot(w, tape);
+		w.flush();
+
+		checkInvalid("an empty file", "", path, "Not a snapshot");
+		checkInvalid("a text document", "{a: 1, b: 2, c: 3, d: 4}", path, "Not a snapshot");
+		checkInvalid("only the header", data.substr(0, 24), path, "Truncated snapshot");
+		checkInvalid(
+			"a truncated snapshot", data.substr(0, data.size() - 1),
+			path, "Truncated snapshot");
+		checkInvalid("trailing data", data + "x", path, "Truncated snapshot");
+
+		std::string version = data;
+		version[4] += 1;
+		checkInvalid(
+			"a different version", version,
+			path, "Unsupported snapshot version or byte order");
+
+		// The root array's end word points at the wrong place
+		std::string corrupt = data;
+		corrupt[24] += 1;
+		checkInvalid("a corrupt root", corrupt, path, "Corrupt snapshot");
+	}
+
+	unlink(path.c_str());
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+#include <mason/keys.h>
+#include <mason/mason.h>
+#include <mason/writer.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void fail(const std::string &what)
+{
+	std::cerr << "FAIL: " << what << '\n';
+	failures += 1;
+}
+
+static std::string serialize(Mason::Value &val)
+{
+	std::string out;
+	Mason::Writer w(out);
+	Mason::serialize(w, val);
+	w.flush();
+	return out;
+}
+
+// Parse a stream into the same Value over and over,
+// and compare each document with parsing it on its own
+static void check(
+	const std::string &stream, const std::vector<std::string> &docs,
+	const std::string &expectedErr = "")
+{
+	for (int fromMemory = 0; fromMemory < 2; ++fromMemory) {
+		std::istringstream is(stream);
+		Mason::KeyTable keys;
+		Mason::StreamParser parser = fromMemory ?
+			Mason::StreamParser(stream, 100, &keys) :
+			Mason::StreamParser(is, 100, &keys);
+		Mason::Value val;
+		size_t n = 0;
+		while (parser.next(val)) {
+			if (n >= docs.size()) {
+				fail("'" + stream + "': too many documents");
+				break;
+			}
+
+			Mason::Value expected;
+			Mason::parse(docs[n], expected);
+			if (serialize(val) != serialize(expected)) {
+				fail("'" + stream + "': document " + std::to_string(n) +
+					" is " + serialize(val));
+			}
+			n += 1;
+		}
+
+		if (n != docs.size() || parser.error() != expectedErr) {
+			fail("'" + stream + "': got " + std::to_string(n) +
+				" documents and error '" + parser.error() + "'");
+		}
+	}
+}
+
+int main()
+{
+	check("", {});
+	check("1 2 3", {"1", "2", "3"});
+	check(
+		"{a: 1, b: [1, 2, 3]}\n{b: [4], a: {c: 2}}\n// comment\n{}\n[1, {a: 1}]\n",
+		{"{a: 1, b: [1, 2, 3]}", "{b: [4], a: {c: 2}}", "{}", "[1, {a: 1}]"});
+	check(
+		"{a: [1, 2, 3, 4], b: {c: 1, d: 2}} {a: [5], b: {d: 3}} {a: \"x\"}",
+		{"{a: [1, 2, 3, 4], b: {c: 1, d: 2}}", "{a: [5], b: {d: 3}}", "{a: \"x\"}"});
+	check("{a: 1} {a: 1_0}", {"{a: 1}"}, "1:13: Expected separator, '}' or EOF");
+
+	// Values are reused between documents, but not kept alive
+	// once nothing in the new document uses them
+	Mason::StreamParser parser(std::string_view("{a: [1, 2], b: {c: 3}} {}"));
+	Mason::Value val;
+	parser.next(val);
+	std::weak_ptr<Mason::Value> a = val.as<Mason::Object>()->at("a");
+	std::weak_ptr<Mason::Value> b = val.as<Mason::Object>()->at("b");
+	parser.next(val);
+	if (!a.expired() || !b.expired()) {
+		fail("members of an old document are kept alive");
+	}
+
+	if (failures > 0) {
+		std::cerr << failures << " failures\n";
+		return 1;
+	}
+
+	return 0;
+}